@@ -1,6 +1,43 @@
 #include <GL/freeglut.h>
+#include <GL/glext.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RASTER_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define RASTER_USE_SSE2 0
+#endif
 #include <cmath>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <atomic>
+#include <new>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(OFFICE_SELFTEST) && !defined(_WIN32)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 // --------------------------------------------------
 // GLOBAL FLAGS & CONSTANTS
@@ -8,11 +45,15 @@
 bool showDoor2D    = true;
 bool showWindows2D = true;
 bool showTable2D   = true;
+bool showFootprints2D = false;  // opt-in (4): the plan's default look is outlines
 bool is3DMode      = false;
 
 int gWindowWidth  = 1000;
 int gWindowHeight = 900;
 
+// Background (glClearColor, also the 2D plan buffers)
+const float CLEAR_R = 0.05f, CLEAR_G = 0.05f, CLEAR_B = 0.10f;
+
 // Room dimensions (shared between camera & drawing)
 const float ROOM_HALF_WIDTH  = 6.0f; // x
 const float ROOM_HALF_DEPTH  = 8.0f; // z
@@ -42,16 +83,43 @@ bool  doorOpen     = false;   // logical state (target)
 const float DOOR_MAX_ANGLE = 90.0f;
 
 // --------------------------------------------------
-// 2D HELPERS (Bresenham + Midpoint Circle)
+// FRAME STATS (draw calls + heap allocations, checked by --selftest)
 // --------------------------------------------------
-void drawPixel(int x, int y)
+struct FrameStats
+{
+    int drawCalls;       // bumped at each glDrawElements, glDrawPixels and glutWireCube
+    int culledObjects;
+};
+
+FrameStats frameStats = {};
+
+#ifdef OFFICE_SELFTEST
+std::atomic<long> heapAllocCount(0);
+
+// Global replacement for the allocation budgets; self-test builds only so
+// the shipping app keeps the default allocator. GCC's
+// -Wmismatched-new-delete can't see the pairing.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size)
 {
-    glBegin(GL_POINTS);
-    glVertex2i(x, y);
-    glEnd();
+    heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
 }
 
-void drawLineBresenham(int x1, int y1, int x2, int y2)
+void operator delete(void* p) noexcept              { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#endif
+
+// --------------------------------------------------
+// 2D HELPERS (Bresenham + Midpoint Circle)
+// --------------------------------------------------
+// Reference per-pixel algorithms; plot(x, y) receives every pixel. The
+// span kernels below must reproduce them exactly (verifyRasterKernels).
+template <typename Plot>
+void drawLineBresenham(int x1, int y1, int x2, int y2, Plot plot)
 {
     int dx = std::abs(x2 - x1);
     int dy = std::abs(y2 - y1);
@@ -61,7 +129,7 @@ void drawLineBresenham(int x1, int y1, int x2, int y2)
 
     while (true)
     {
-        drawPixel(x1, y1);
+        plot(x1, y1);
         if (x1 == x2 && y1 == y2) break;
 
         int e2 = 2 * err;
@@ -70,21 +138,22 @@ void drawLineBresenham(int x1, int y1, int x2, int y2)
     }
 }
 
-void drawCircleMidpoint(int xc, int yc, int r)
+template <typename Plot>
+void drawCircleMidpoint(int xc, int yc, int r, Plot plot)
 {
     int x = 0, y = r;
     int d = 1 - r;
 
     while (x <= y)
     {
-        drawPixel(xc + x, yc + y);
-        drawPixel(xc - x, yc + y);
-        drawPixel(xc + x, yc - y);
-        drawPixel(xc - x, yc - y);
-        drawPixel(xc + y, yc + x);
-        drawPixel(xc - y, yc + x);
-        drawPixel(xc + y, yc - x);
-        drawPixel(xc - y, yc - x);
+        plot(xc + x, yc + y);
+        plot(xc - x, yc + y);
+        plot(xc + x, yc - y);
+        plot(xc - x, yc - y);
+        plot(xc + y, yc + x);
+        plot(xc - y, yc + x);
+        plot(xc + y, yc - x);
+        plot(xc - y, yc - x);
 
         if (d < 0)
             d += 2 * x + 3;
@@ -98,784 +167,5799 @@ void drawCircleMidpoint(int xc, int yc, int r)
 }
 
 // --------------------------------------------------
-// 2D FLOOR PLAN (TOP VIEW)
+// RASTER KERNELS (span based, SSE2 fills)
 // --------------------------------------------------
-void drawOfficePlan2D()
+// All kernels write into a PlanTile: a clip rectangle over a 32-bit pixel
+// buffer, y up. Primitives are decomposed into horizontal spans wherever
+// the shape allows so the inner loop is a vector store, not a branch per
+// pixel. Pixels are packed R | G << 8 | B << 16 | A << 24.
+struct PlanTile
 {
-    int left   = 100;
-    int right  = 900;
-    int bottom = 100;
-    int top    = 700;
-
-    // Room outline
-    glColor3f(1.0f, 1.0f, 1.0f);
-    drawLineBresenham(left, bottom, right, bottom);
-    drawLineBresenham(right, bottom, right, top);
-    drawLineBresenham(right, top, left, top);
-    drawLineBresenham(left, top, left, bottom);
+    uint32_t* pixels;   // pixel (x0, y0)
+    int       stride;   // in pixels
+    int       x0, y0;   // image coords, y up
+    int       w, h;
+};
 
-    // Round table (center)
-    if (showTable2D)
-    {
-        glColor3f(1.0f, 0.8f, 0.0f);
-        int cx = 500;
-        int cy = 420;
-        int radius = 120;
-        drawCircleMidpoint(cx, cy, radius);
-    }
+// Working storage for the disc and polygon kernels. Each thread that
+// rasterizes keeps one and passes it to every call, so once it has grown
+// to the largest shape the kernels don't allocate.
+struct PolygonEdge { int lo[2]; int hi[2]; };   // low -> high y
 
-    // Desk (left)
-    glColor3f(1.0f, 0.5f, 0.0f);
-    int dx1 = 220, dy1 = 450;
-    int dx2 = 420, dy2 = 520;
-    drawLineBresenham(dx1, dy1, dx2, dy1);
-    drawLineBresenham(dx2, dy1, dx2, dy2);
-    drawLineBresenham(dx2, dy2, dx1, dy2);
-    drawLineBresenham(dx1, dy2, dx1, dy1);
+struct RasterScratch
+{
+    std::vector<int>         halfWidth;   // disc: per row
+    std::vector<PolygonEdge> edges;       // polygon: by lower y
+    std::vector<int>         active;
+    std::vector<double>      xs;
+};
 
-    // Chair
-    glColor3f(0.0f, 0.7f, 1.0f);
-    int cx1 = 440, cy1 = 450;
-    int cx2 = 490, cy2 = 500;
-    drawLineBresenham(cx1, cy1, cx2, cy1);
-    drawLineBresenham(cx2, cy1, cx2, cy2);
-    drawLineBresenham(cx2, cy2, cx1, cy2);
-    drawLineBresenham(cx1, cy2, cx1, cy1);
+uint32_t packColor(float r, float g, float b)
+{
+    uint32_t R = (uint32_t)(r * 255.0f + 0.5f);
+    uint32_t G = (uint32_t)(g * 255.0f + 0.5f);
+    uint32_t B = (uint32_t)(b * 255.0f + 0.5f);
+    return R | (G << 8) | (B << 16) | 0xFF000000u;
+}
 
-    // Door (bottom)
-    if (showDoor2D)
+inline void fillSpan(uint32_t* dst, int n, uint32_t c)
+{
+    int i = 0;
+#if RASTER_USE_SSE2
+    __m128i v = _mm_set1_epi32((int)c);
+    for (; i + 16 <= n; i += 16)
     {
-        glColor3f(0.0f, 1.0f, 0.0f);
-        int doorLeft  = 440;
-        int doorRight = 560;
-        int doorHeight = 60;
-        drawLineBresenham(doorLeft,  bottom, doorLeft,  bottom + doorHeight);
-        drawLineBresenham(doorRight, bottom, doorRight, bottom + doorHeight);
+        _mm_storeu_si128((__m128i*)(dst + i),      v);
+        _mm_storeu_si128((__m128i*)(dst + i + 4),  v);
+        _mm_storeu_si128((__m128i*)(dst + i + 8),  v);
+        _mm_storeu_si128((__m128i*)(dst + i + 12), v);
     }
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+#endif
+    for (; i < n; ++i)
+        dst[i] = c;
+}
 
-    // Windows (top)
-    if (showWindows2D)
-    {
-        glColor3f(0.2f, 0.8f, 1.0f);
-        drawLineBresenham(150, top, 300, top);
-        drawLineBresenham(700, top, 850, top);
-    }
+inline void tilePut(const PlanTile& t, int x, int y, uint32_t c)
+{
+    if (x < t.x0 || x >= t.x0 + t.w || y < t.y0 || y >= t.y0 + t.h) return;
+    t.pixels[(ptrdiff_t)(y - t.y0) * t.stride + (x - t.x0)] = c;
 }
 
-// --------------------------------------------------
-// 3D HELPERS
-// --------------------------------------------------
+// Inclusive span [xa, xb] on row y, clipped to the tile
+inline void tileSpan(const PlanTile& t, int xa, int xb, int y, uint32_t c)
+{
+    if (y < t.y0 || y >= t.y0 + t.h) return;
+    xa = std::max(xa, t.x0);
+    xb = std::min(xb, t.x0 + t.w - 1);
+    if (xa > xb) return;
+    fillSpan(t.pixels + (ptrdiff_t)(y - t.y0) * t.stride + (xa - t.x0), xb - xa + 1, c);
+}
 
-// Unit cube centered at origin (1x1x1)
-void drawUnitBox()
-{
-    float h = 0.5f;
-    glBegin(GL_QUADS);
-
-    // Top
-    glNormal3f(0, 1, 0);
-    glVertex3f(-h, h, -h);
-    glVertex3f( h, h, -h);
-    glVertex3f( h, h,  h);
-    glVertex3f(-h, h,  h);
-
-    // Bottom
-    glNormal3f(0, -1, 0);
-    glVertex3f(-h, -h, -h);
-    glVertex3f(-h, -h,  h);
-    glVertex3f( h, -h,  h);
-    glVertex3f( h, -h, -h);
-
-    // Front
-    glNormal3f(0, 0, 1);
-    glVertex3f(-h, -h, h);
-    glVertex3f( h, -h, h);
-    glVertex3f( h,  h, h);
-    glVertex3f(-h,  h, h);
-
-    // Back
-    glNormal3f(0, 0, -1);
-    glVertex3f(-h, -h, -h);
-    glVertex3f(-h,  h, -h);
-    glVertex3f( h,  h, -h);
-    glVertex3f( h, -h, -h);
-
-    // Left
-    glNormal3f(-1, 0, 0);
-    glVertex3f(-h, -h, -h);
-    glVertex3f(-h, -h,  h);
-    glVertex3f(-h,  h,  h);
-    glVertex3f(-h,  h, -h);
-
-    // Right
-    glNormal3f(1, 0, 0);
-    glVertex3f(h, -h, -h);
-    glVertex3f(h,  h, -h);
-    glVertex3f(h,  h,  h);
-    glVertex3f(h, -h,  h);
-
-    glEnd();
-}
-
-// Cylinder for table / plant pot / lamp
-void drawCylinder(float radius, float height, int segments = 32)
+long long floorDiv(long long a, long long b) { return (a >= 0) ? a / b : -((-a + b - 1) / b); }
+long long ceilDiv (long long a, long long b) { return -floorDiv(-a, b); }
+
+// Same pixels as drawLineBresenham: after k major steps the minor axis has
+// advanced floor((2*k*minor + major - 1) / (2*major)). Inverting that gives
+// the run of k on each minor step, so x-major lines become horizontal
+// spans, and the clip rectangle is applied before any pixel is touched.
+void rasterLine(const PlanTile& t, int x1, int y1, int x2, int y2, uint32_t c)
 {
-    float halfH = height * 0.5f;
+    int tx1 = t.x0 + t.w - 1;
+    int ty1 = t.y0 + t.h - 1;
+    if (std::max(x1, x2) < t.x0 || std::min(x1, x2) > tx1 ||
+        std::max(y1, y2) < t.y0 || std::min(y1, y2) > ty1)
+        return;
 
-    // Side
-    glBegin(GL_QUAD_STRIP);
-    for (int i = 0; i <= segments; ++i)
-    {
-        float theta = (2.0f * 3.1415926f * i) / segments;
-        float x = radius * std::cos(theta);
-        float z = radius * std::sin(theta);
-        glNormal3f(x, 0.0f, z);
-        glVertex3f(x, -halfH, z);
-        glVertex3f(x,  halfH, z);
-    }
-    glEnd();
+    int dx = std::abs(x2 - x1);
+    int dy = std::abs(y2 - y1);
+    if (dx == 0 && dy == 0) { tilePut(t, x1, y1, c); return; }
 
-    // Top
-    glBegin(GL_TRIANGLE_FAN);
-    glNormal3f(0, 1, 0);
-    glVertex3f(0, halfH, 0);
-    for (int i = 0; i <= segments; ++i)
+    bool xMajor = dx >= dy;
+    long long M  = xMajor ? dx : dy;
+    long long m  = xMajor ? dy : dx;
+    int a0 = xMajor ? x1 : y1,  sa = ((xMajor ? x2 - x1 : y2 - y1) > 0) ? 1 : -1;
+    int b0 = xMajor ? y1 : x1,  sb = ((xMajor ? y2 - y1 : x2 - x1) > 0) ? 1 : -1;
+    int aLo = xMajor ? t.x0 : t.y0, aHi = xMajor ? tx1 : ty1;
+    int bLo = xMajor ? t.y0 : t.x0, bHi = xMajor ? ty1 : tx1;
+
+    long long kMin = 0, kMax = M;
+    if (sa > 0) { kMin = std::max(kMin, (long long)aLo - a0); kMax = std::min(kMax, (long long)aHi - a0); }
+    else        { kMin = std::max(kMin, (long long)a0 - aHi); kMax = std::min(kMax, (long long)a0 - aLo); }
+
+    long long jLo = (sb > 0) ? (long long)bLo - b0 : (long long)b0 - bHi;
+    long long jHi = (sb > 0) ? (long long)bHi - b0 : (long long)b0 - bLo;
+    if (m > 0)
     {
-        float theta = (2.0f * 3.1415926f * i) / segments;
-        float x = radius * std::cos(theta);
-        float z = radius * std::sin(theta);
-        glVertex3f(x, halfH, z);
+        kMin = std::max(kMin, ceilDiv (2 * M * jLo - M + 1,   2 * m));
+        kMax = std::min(kMax, floorDiv(2 * M * (jHi + 1) - M, 2 * m));
     }
-    glEnd();
-
-    // Bottom
-    glBegin(GL_TRIANGLE_FAN);
-    glNormal3f(0, -1, 0);
-    glVertex3f(0, -halfH, 0);
-    for (int i = 0; i <= segments; ++i)
+    else if (jLo > 0 || jHi < 0)
     {
-        float theta = (2.0f * 3.1415926f * i) / segments;
-        float x = radius * std::cos(theta);
-        float z = radius * std::sin(theta);
-        glVertex3f(x, -halfH, z);
+        return;
     }
-    glEnd();
-}
-
-// --------------------------------------------------
-// DRAW SIMPLE PERSON
-// --------------------------------------------------
-void drawSeatedPerson()
-{
-    // Very simple blocky character sitting at the chair
+    if (kMin > kMax) return;
 
-    // Legs
-    glColor3f(0.1f, 0.1f, 0.3f); // dark pants
-    glPushMatrix();
-    glTranslatef(-0.18f, 0.4f, 0.1f);  // left leg
-    glScalef(0.12f, 0.8f, 0.12f);
-    drawUnitBox();
-    glPopMatrix();
-
-    glPushMatrix();
-    glTranslatef(0.18f, 0.4f, 0.1f);   // right leg
-    glScalef(0.12f, 0.8f, 0.12f);
-    drawUnitBox();
-    glPopMatrix();
-
-    // Torso
-    glColor3f(0.0f, 0.4f, 0.8f); // shirt
-    glPushMatrix();
-    glTranslatef(0.0f, 0.9f, -0.05f);
-    glScalef(0.45f, 0.7f, 0.25f);
-    drawUnitBox();
-    glPopMatrix();
+    long long jFirst = (2 * kMin * m + M - 1) / (2 * M);
+    long long jLast  = (2 * kMax * m + M - 1) / (2 * M);
 
-    // Head
-    glColor3f(1.0f, 0.8f, 0.6f);
-    glPushMatrix();
-    glTranslatef(0.0f, 1.4f, -0.05f);
-    glScalef(0.30f, 0.35f, 0.30f);
-    drawUnitBox();
-    glPopMatrix();
+    for (long long j = jFirst; j <= jLast; ++j)
+    {
+        long long ks = kMin, ke = kMax;
+        if (m > 0)
+        {
+            ks = std::max(ks, ceilDiv (2 * M * j - M + 1,       2 * m));
+            ke = std::min(ke, floorDiv(2 * M * (j + 1) - M,     2 * m));
+        }
+        if (ks > ke) continue;
 
-    // Left arm reaching to keyboard
-    glColor3f(0.0f, 0.4f, 0.8f);
-    glPushMatrix();
-    glTranslatef(-0.32f, 0.95f, -0.25f);
-    glRotatef(-20.0f, 1, 0, 0);
-    glScalef(0.12f, 0.4f, 0.12f);
-    drawUnitBox();
-    glPopMatrix();
+        int b  = b0 + sb * (int)j;
+        int aS = a0 + sa * (int)ks;
+        int aE = a0 + sa * (int)ke;
+        int lo = std::min(aS, aE), hi = std::max(aS, aE);
 
-    // Right arm
-    glPushMatrix();
-    glTranslatef(0.32f, 0.95f, -0.25f);
-    glRotatef(-15.0f, 1, 0, 0);
-    glScalef(0.12f, 0.4f, 0.12f);
-    drawUnitBox();
-    glPopMatrix();
+        if (xMajor)
+        {
+            fillSpan(t.pixels + (ptrdiff_t)(b - t.y0) * t.stride + (lo - t.x0), hi - lo + 1, c);
+        }
+        else
+        {
+            uint32_t* p = t.pixels + (ptrdiff_t)(lo - t.y0) * t.stride + (b - t.x0);
+            for (int y = lo; y <= hi; ++y, p += t.stride)
+                *p = c;
+        }
+    }
 }
 
-// --------------------------------------------------
-// 3D ROOM, FURNITURE, DOOR, FAN, LIGHTS
-// --------------------------------------------------
-void drawRoomAndObjects3D()
-{
-    // FLOOR
-    glColor3f(0.12f, 0.12f, 0.16f);
-    glBegin(GL_QUADS);
-    glNormal3f(0, 1, 0);
-    glVertex3f(-ROOM_HALF_WIDTH, 0.0f, -ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH, 0.0f, -ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH, 0.0f,  ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, 0.0f,  ROOM_HALF_DEPTH);
-    glEnd();
-
-    // CEILING
-    glColor3f(0.20f, 0.20f, 0.25f);
-    glBegin(GL_QUADS);
-    glNormal3f(0, -1, 0);
-    glVertex3f(-ROOM_HALF_WIDTH, ROOM_HEIGHT, -ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, ROOM_HEIGHT,  ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH, ROOM_HEIGHT,  ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH, ROOM_HEIGHT, -ROOM_HALF_DEPTH);
-    glEnd();
-
-    // Ceiling light panels (2 big white rectangles)
-    glColor3f(0.95f, 0.95f, 1.0f);
-    glPushMatrix();
-    glTranslatef(-1.5f, ROOM_HEIGHT - 0.02f, -1.0f);
-    glScalef(3.0f, 0.05f, 0.8f);
-    drawUnitBox();
-    glPopMatrix();
+// Midpoint circle outline. Octants where x runs along a fixed y are
+// emitted as spans; the steep octants are plotted per pixel.
+void rasterCircle(const PlanTile& t, int xc, int yc, int r, uint32_t c)
+{
+    if (xc + r < t.x0 || xc - r >= t.x0 + t.w ||
+        yc + r < t.y0 || yc - r >= t.y0 + t.h)
+        return;
 
-    glPushMatrix();
-    glTranslatef( 1.5f, ROOM_HEIGHT - 0.02f, -1.0f);
-    glScalef(3.0f, 0.05f, 0.8f);
-    drawUnitBox();
-    glPopMatrix();
+    int x = 0, y = r;
+    int d = 1 - r;
+    int runStart = 0;
 
-    // WALLS (inside facing)
-    glColor3f(0.80f, 0.80f, 0.86f);
-
-    // Back wall (z -)
-    glBegin(GL_QUADS);
-    glNormal3f(0, 0, 1);
-    glVertex3f(-ROOM_HALF_WIDTH, 0.0f, -ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, ROOM_HEIGHT, -ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH, ROOM_HEIGHT, -ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH, 0.0f, -ROOM_HALF_DEPTH);
-    glEnd();
-
-    // Front wall (z +) with door gap
-    glBegin(GL_QUADS);
-    glNormal3f(0, 0, -1);
-
-    // Left segment
-    glVertex3f(-ROOM_HALF_WIDTH, 0.0f,  ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, ROOM_HEIGHT, ROOM_HALF_DEPTH);
-    glVertex3f(-1.5f,           ROOM_HEIGHT, ROOM_HALF_DEPTH);
-    glVertex3f(-1.5f,           0.0f,        ROOM_HALF_DEPTH);
-
-    // Right segment
-    glVertex3f( 1.5f,           0.0f,        ROOM_HALF_DEPTH);
-    glVertex3f( 1.5f,           ROOM_HEIGHT, ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH,ROOM_HEIGHT, ROOM_HALF_DEPTH);
-    glVertex3f( ROOM_HALF_WIDTH,0.0f,        ROOM_HALF_DEPTH);
-    glEnd();
-
-    // Left wall (x -)
-    glBegin(GL_QUADS);
-    glNormal3f(1, 0, 0);
-    glVertex3f(-ROOM_HALF_WIDTH, 0.0f, -ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, 0.0f,  ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, ROOM_HEIGHT, ROOM_HALF_DEPTH);
-    glVertex3f(-ROOM_HALF_WIDTH, ROOM_HEIGHT,-ROOM_HALF_DEPTH);
-    glEnd();
-
-    // Right wall (x +)
-    glBegin(GL_QUADS);
-    glNormal3f(-1, 0, 0);
-    glVertex3f(ROOM_HALF_WIDTH, 0.0f, -ROOM_HALF_DEPTH);
-    glVertex3f(ROOM_HALF_WIDTH, ROOM_HEIGHT,-ROOM_HALF_DEPTH);
-    glVertex3f(ROOM_HALF_WIDTH, ROOM_HEIGHT, ROOM_HALF_DEPTH);
-    glVertex3f(ROOM_HALF_WIDTH, 0.0f,  ROOM_HALF_DEPTH);
-    glEnd();
-
-    // ------------------ Furniture ------------------
-
-    // Meeting table (cylinder)
-    glColor3f(1.0f, 0.8f, 0.2f);
-    glPushMatrix();
-    glTranslatef(0.0f, 0.75f, 0.0f);
-    glScalef(1.0f, 0.5f, 1.0f);
-    drawCylinder(1.5f, 1.0f, 40);
-    glPopMatrix();
+    while (x <= y)
+    {
+        tilePut(t, xc + y, yc + x, c);
+        tilePut(t, xc - y, yc + x, c);
+        tilePut(t, xc + y, yc - x, c);
+        tilePut(t, xc - y, yc - x, c);
 
-    // Desk (left)
-    glColor3f(0.90f, 0.55f, 0.25f);
-    glPushMatrix();
-    glTranslatef(-3.5f, 0.8f, -1.2f);
-    glScalef(2.6f, 0.2f, 1.2f);
-    drawUnitBox();
-    glPopMatrix();
+        int rowY = y;
+        if (d < 0)
+            d += 2 * x + 3;
+        else
+        {
+            d += 2 * (x - y) + 5;
+            y--;
+        }
+        x++;
 
-    // Desk legs
-    glColor3f(0.4f, 0.25f, 0.18f);
-    float legHeight = 0.8f;
-    float legSize   = 0.1f;
-    // front-left leg
-    glPushMatrix();
-    glTranslatef(-4.6f, legHeight * 0.5f, -1.8f);
-    glScalef(legSize, legHeight, legSize);
-    drawUnitBox();
-    glPopMatrix();
-    // front-right leg
-    glPushMatrix();
-    glTranslatef(-2.4f, legHeight * 0.5f, -1.8f);
-    glScalef(legSize, legHeight, legSize);
-    drawUnitBox();
-    glPopMatrix();
+        if (y != rowY || x > y)
+        {
+            tileSpan(t, xc + runStart, xc + x - 1, yc + rowY, c);
+            tileSpan(t, xc - x + 1, xc - runStart, yc + rowY, c);
+            tileSpan(t, xc + runStart, xc + x - 1, yc - rowY, c);
+            tileSpan(t, xc - x + 1, xc - runStart, yc - rowY, c);
+            runStart = x;
+        }
+    }
+}
 
-    // Chair (seat + back)
-    glColor3f(0.2f, 0.6f, 1.0f);
-    // seat
-    glPushMatrix();
-    glTranslatef(-1.5f, 0.5f, -1.0f);
-    glScalef(0.9f, 0.18f, 0.9f);
-    drawUnitBox();
-    glPopMatrix();
-    // backrest
-    glPushMatrix();
-    glTranslatef(-1.5f, 1.0f, -1.6f);
-    glScalef(0.9f, 0.7f, 0.15f);
-    drawUnitBox();
-    glPopMatrix();
+// Inclusive corners, any order
+void rasterRectFill(const PlanTile& t, int x1, int y1, int x2, int y2, uint32_t c)
+{
+    if (x1 > x2) std::swap(x1, x2);
+    if (y1 > y2) std::swap(y1, y2);
+    y1 = std::max(y1, t.y0);
+    y2 = std::min(y2, t.y0 + t.h - 1);
+    for (int y = y1; y <= y2; ++y)
+        tileSpan(t, x1, x2, y, c);
+}
 
-    // Person sitting on the chair using the computer
-    glPushMatrix();
-    glTranslatef(-1.5f, 0.0f, -1.0f);
-    drawSeatedPerson();
-    glPopMatrix();
+// Disc whose edge is exactly the midpoint circle of the same radius
+void rasterDiscFill(const PlanTile& t, RasterScratch& scratch, int xc, int yc, int r, uint32_t c)
+{
+    if (r < 0 ||
+        xc + r < t.x0 || xc - r >= t.x0 + t.w ||
+        yc + r < t.y0 || yc - r >= t.y0 + t.h)
+        return;
 
-    // Cabinet (right side)
-    glColor3f(0.7f, 0.7f, 0.75f);
-    glPushMatrix();
-    glTranslatef(ROOM_HALF_WIDTH - 1.0f, 1.1f, -ROOM_HALF_DEPTH + 2.0f);
-    glScalef(1.0f, 2.2f, 0.7f);
-    drawUnitBox();
-    glPopMatrix();
+    // Half width of each row |dy| = 0..r, taken from the outline
+    std::vector<int>& halfWidth = scratch.halfWidth;
+    halfWidth.assign(r + 1, 0);
+    int x = 0, y = r;
+    int d = 1 - r;
+    while (x <= y)
+    {
+        halfWidth[y] = std::max(halfWidth[y], x);
+        halfWidth[x] = std::max(halfWidth[x], y);
+        if (d < 0)
+            d += 2 * x + 3;
+        else
+        {
+            d += 2 * (x - y) + 5;
+            y--;
+        }
+        x++;
+    }
 
-    // Whiteboard (back wall)
-    glColor3f(0.95f, 0.95f, 1.0f);
-    glPushMatrix();
-    glTranslatef(0.0f, 1.6f, -ROOM_HALF_DEPTH + 0.02f);
-    glScalef(3.0f, 1.4f, 0.05f);
-    drawUnitBox();
-    glPopMatrix();
+    for (int dy = 0; dy <= r; ++dy)
+    {
+        tileSpan(t, xc - halfWidth[dy], xc + halfWidth[dy], yc + dy, c);
+        if (dy > 0) tileSpan(t, xc - halfWidth[dy], xc + halfWidth[dy], yc - dy, c);
+    }
+}
 
-    // Monitor on desk
-    glColor3f(0.05f, 0.05f, 0.05f);
-    glPushMatrix();
-    glTranslatef(-3.4f, 1.15f, -1.2f);
-    glScalef(0.9f, 0.6f, 0.1f);
-    drawUnitBox(); // screen
-    glPopMatrix();
-    // stand
-    glPushMatrix();
-    glTranslatef(-3.4f, 0.95f, -1.25f);
-    glScalef(0.1f, 0.4f, 0.1f);
-    drawUnitBox();
-    glPopMatrix();
+// Even-odd scanline fill of a closed polygon (xy = x0,y0,x1,y1,...).
+// Pixel (x, y) is inside when an odd number of edges with y0 <= y < y1
+// cross row y at or left of x.
+double edgeXAt(const int* a, const int* b, int y)
+{
+    return a[0] + (double)(y - a[1]) * (b[0] - a[0]) / (double)(b[1] - a[1]);
+}
 
-    // Keyboard (simple thin box)
-    glColor3f(0.15f, 0.15f, 0.18f);
-    glPushMatrix();
-    glTranslatef(-2.9f, 0.9f, -1.2f);
-    glScalef(0.9f, 0.05f, 0.25f);
-    drawUnitBox();
-    glPopMatrix();
+void rasterPolygonFill(const PlanTile& t, RasterScratch& scratch, const int* xy, int n, uint32_t c)
+{
+    if (n < 3) return;
 
-    // Table Lamp on desk
-    // Base
-    glPushMatrix();
-    glTranslatef(-3.0f, 0.9f, -0.9f);
-    glColor3f(0.3f, 0.2f, 0.1f);
-    glScalef(1.0f, 0.3f, 1.0f);
-    drawCylinder(0.12f, 0.08f, 20);
-    glPopMatrix();
+    // Edge table ordered by lower y
+    std::vector<PolygonEdge>& edges = scratch.edges;
+    edges.clear();
+    int yMin = xy[1], yMax = xy[1];
+    for (int i = 0; i < n; ++i)
+    {
+        const int* a = &xy[2 * i];
+        const int* b = &xy[2 * ((i + 1) % n)];
+        yMin = std::min(yMin, a[1]);
+        yMax = std::max(yMax, a[1]);
+        if (a[1] == b[1]) continue;
 
-    // Neck
-    glPushMatrix();
-    glTranslatef(-3.0f, 1.05f, -0.9f);
-    glColor3f(0.7f, 0.7f, 0.7f);
-    glScalef(1.0f, 1.0f, 1.0f);
-    drawCylinder(0.05f, 0.35f, 16);
-    glPopMatrix();
+        PolygonEdge e;
+        const int* l = (a[1] < b[1]) ? a : b;
+        const int* h = (a[1] < b[1]) ? b : a;
+        e.lo[0] = l[0]; e.lo[1] = l[1];
+        e.hi[0] = h[0]; e.hi[1] = h[1];
+        edges.push_back(e);
+    }
+    std::sort(edges.begin(), edges.end(),
+              [](const PolygonEdge& a, const PolygonEdge& b) { return a.lo[1] < b.lo[1]; });
 
-    // Shade
-    glPushMatrix();
-    glTranslatef(-3.0f, 1.3f, -0.9f);
-    glColor3f(1.0f, 0.95f, 0.75f); // warm light
-    drawCylinder(0.18f, 0.30f, 24);
-    glPopMatrix();
+    int yStart = std::max(yMin, t.y0);
+    int yEnd   = std::min(yMax - 1, t.y0 + t.h - 1);
 
-    // Plant (front-left corner)
-    glPushMatrix();
-    // pot
-    glColor3f(0.6f, 0.3f, 0.15f);
-    glTranslatef(-ROOM_HALF_WIDTH + 1.0f, 0.4f, ROOM_HALF_DEPTH - 1.0f);
-    glScalef(1.0f, 0.8f, 1.0f);
-    drawCylinder(0.3f, 0.6f, 24);
-    glPopMatrix();
+    std::vector<int>&    active = scratch.active;
+    std::vector<double>& xs     = scratch.xs;
+    active.clear();
+    size_t next = 0;
 
-    glPushMatrix();
-    // leaves (simple box)
-    glColor3f(0.1f, 0.6f, 0.2f);
-    glTranslatef(-ROOM_HALF_WIDTH + 1.0f, 1.1f, ROOM_HALF_DEPTH - 1.0f);
-    glScalef(0.6f, 1.0f, 0.6f);
-    drawUnitBox();
-    glPopMatrix();
+    for (int y = yStart; y <= yEnd; ++y)
+    {
+        while (next < edges.size() && edges[next].lo[1] <= y)
+            active.push_back((int)next++);
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](int e) { return edges[e].hi[1] <= y; }),
+                     active.end());
 
-    // --------------- Door (animated single panel) ---------------
+        xs.clear();
+        for (size_t i = 0; i < active.size(); ++i)
+            xs.push_back(edgeXAt(edges[active[i]].lo, edges[active[i]].hi, y));
+        std::sort(xs.begin(), xs.end());
 
-    const float DOOR_WIDTH  = 3.0f;
-    const float DOOR_HEIGHT = 2.2f;
-    const float DOOR_THICK  = 0.08f;
+        for (size_t i = 0; i + 1 < xs.size(); i += 2)
+            tileSpan(t, (int)std::ceil(xs[i]), (int)std::ceil(xs[i + 1]) - 1, y, c);
+    }
+}
 
-    glPushMatrix();
-    // Hinge at x=-1.5, z=ROOM_HALF_DEPTH
-    glTranslatef(-1.5f, DOOR_HEIGHT * 0.5f, ROOM_HALF_DEPTH + 0.01f);
-    glRotatef(doorAngleDeg, 0.0f, 1.0f, 0.0f);
-    // Move door so hinge is at its left edge
-    glTranslatef(DOOR_WIDTH * 0.5f, 0.0f, 0.0f);
-
-    glColor3f(0.95f, 0.95f, 0.98f);
-    glScalef(DOOR_WIDTH, DOOR_HEIGHT, DOOR_THICK);
-    drawUnitBox();
-    glPopMatrix();
+// Kernels against the reference algorithms on random shapes and clip
+// rectangles; every pixel must match.
+bool verifyRasterKernels()
+{
+    const int W = 160, H = 120;
+    std::vector<uint32_t> ref(W * H), out(W * H);
+    RasterScratch scratch;
+    unsigned seed = 12345;
+    auto rnd = [&](int lo, int hi) { seed = seed * 1103515245u + 12345u; return lo + (int)((seed >> 8) % (unsigned)(hi - lo + 1)); };
 
-    // Door handle
-    glPushMatrix();
-    glTranslatef(-1.5f, DOOR_HEIGHT * 0.7f, ROOM_HALF_DEPTH + 0.12f);
-    glRotatef(doorAngleDeg, 0.0f, 1.0f, 0.0f);
-    glTranslatef(0.9f, 0.0f, 0.15f);
-    glColor3f(0.9f, 0.75f, 0.25f);
-    glScalef(0.25f, 0.12f, 0.12f);
-    drawUnitBox();
-    glPopMatrix();
+    int failures = 0;
+    for (int iter = 0; iter < 4000; ++iter)
+    {
+        PlanTile clip = { 0, W, rnd(0, W / 2), rnd(0, H / 2), 0, 0 };
+        clip.w = rnd(1, W - clip.x0);
+        clip.h = rnd(1, H - clip.y0);
+        clip.pixels = &out[(size_t)clip.y0 * W + clip.x0];
 
-    // --------------- Ceiling Fan -------------------
+        std::fill(ref.begin(), ref.end(), 0u);
+        std::fill(out.begin(), out.end(), 0u);
+        auto plotRef = [&](int x, int y)
+        {
+            if (x >= clip.x0 && x < clip.x0 + clip.w && y >= clip.y0 && y < clip.y0 + clip.h)
+                ref[(size_t)y * W + x] = 1u;
+        };
 
-    // Hub
-    glPushMatrix();
-    glTranslatef(0.0f, ROOM_HEIGHT - 0.2f, 0.0f);
-    glRotatef(fanAngleDeg, 0.0f, 1.0f, 0.0f);
+        int kind = iter % 5;
+        if (kind == 0)
+        {
+            int x1 = rnd(-40, W + 40), y1 = rnd(-40, H + 40);
+            int x2 = rnd(-40, W + 40), y2 = rnd(-40, H + 40);
+            drawLineBresenham(x1, y1, x2, y2, plotRef);
+            rasterLine(clip, x1, y1, x2, y2, 1u);
+        }
+        else if (kind == 1)
+        {
+            int xc = rnd(-20, W + 20), yc = rnd(-20, H + 20), r = rnd(0, 90);
+            drawCircleMidpoint(xc, yc, r, plotRef);
+            rasterCircle(clip, xc, yc, r, 1u);
+        }
+        else if (kind == 2)
+        {
+            int x1 = rnd(-20, W + 20), y1 = rnd(-20, H + 20);
+            int x2 = rnd(-20, W + 20), y2 = rnd(-20, H + 20);
+            for (int y = std::min(y1, y2); y <= std::max(y1, y2); ++y)
+                for (int x = std::min(x1, x2); x <= std::max(x1, x2); ++x)
+                    plotRef(x, y);
+            rasterRectFill(clip, x1, y1, x2, y2, 1u);
+        }
+        else if (kind == 3)
+        {
+            // Disc: the outline lies on the fill and each row is one run
+            int xc = rnd(-20, W + 20), yc = rnd(-20, H + 20), r = rnd(0, 90);
+            std::vector<int> lo(2 * r + 1, 1 << 30), hi(2 * r + 1, -(1 << 30));
+            drawCircleMidpoint(xc, yc, r, [&](int x, int y)
+            {
+                lo[y - yc + r] = std::min(lo[y - yc + r], x);
+                hi[y - yc + r] = std::max(hi[y - yc + r], x);
+            });
+            for (int row = 0; row <= 2 * r; ++row)
+                for (int x = lo[row]; x <= hi[row]; ++x)
+                    plotRef(x, yc - r + row);
+            rasterDiscFill(clip, scratch, xc, yc, r, 1u);
+        }
+        else
+        {
+            int n = rnd(3, 9);
+            std::vector<int> poly(2 * n);
+            for (int i = 0; i < n; ++i)
+            {
+                poly[2 * i]     = rnd(-20, W + 20);
+                poly[2 * i + 1] = rnd(-20, H + 20);
+            }
+            for (int y = 0; y < H; ++y)
+                for (int x = 0; x < W; ++x)
+                {
+                    int crossings = 0;
+                    for (int i = 0; i < n; ++i)
+                    {
+                        const int* a = &poly[2 * i];
+                        const int* b = &poly[2 * ((i + 1) % n)];
+                        const int* l = (a[1] < b[1]) ? a : b;
+                        const int* h = (a[1] < b[1]) ? b : a;
+                        if (a[1] != b[1] && l[1] <= y && y < h[1] && edgeXAt(l, h, y) <= x)
+                            ++crossings;
+                    }
+                    if (crossings & 1) plotRef(x, y);
+                }
+            rasterPolygonFill(clip, scratch, &poly[0], n, 1u);
+        }
+        if (ref != out)
+        {
+            if (failures < 5) std::printf("Raster kernel mismatch: case %d (kind %d)\n", iter, kind);
+            ++failures;
+        }
+    }
 
-    glColor3f(0.85f, 0.85f, 0.85f);
-    glScalef(0.3f, 0.1f, 0.3f);
-    drawUnitBox();
-    glPopMatrix();
+    std::printf("Raster kernels: %s (%d mismatches)\n", failures ? "FAIL" : "pixel-exact", failures);
+    return failures == 0;
+}
 
-    // Blades
-    glPushMatrix();
-    glTranslatef(0.0f, ROOM_HEIGHT - 0.25f, 0.0f);
-    glRotatef(fanAngleDeg, 0.0f, 1.0f, 0.0f);
-    glColor3f(0.9f, 0.9f, 0.9f);
+// --------------------------------------------------
+// CONTENT HASH (64-bit FNV-1a)
+// --------------------------------------------------
+const uint64_t HASH_SEED = 14695981039346656037ull;
 
-    for (int i = 0; i < 4; ++i)
+uint64_t hashBytes(const void* data, size_t size, uint64_t h = HASH_SEED)
+{
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < size; ++i)
     {
-        glPushMatrix();
-        glRotatef(i * 90.0f, 0.0f, 1.0f, 0.0f);
-        glTranslatef(1.4f, 0.0f, 0.0f);
-        glScalef(2.8f, 0.05f, 0.3f);
-        drawUnitBox();
-        glPopMatrix();
+        h ^= p[i];
+        h *= 1099511628211ull;
     }
-    glPopMatrix();
+    return h;
 }
 
 // --------------------------------------------------
-// LIGHTING
+// 2D FLOOR PLAN (TOP VIEW)
 // --------------------------------------------------
-void setupLighting()
+// The plan is built as a list of primitives in plan pixel space so the
+// same description can be drawn on screen or rasterized for export.
+enum PlanPrimType { PLAN_LINE, PLAN_CIRCLE, PLAN_RECT_FILL, PLAN_DISC_FILL, PLAN_POLYGON_FILL };
+
+struct PlanPrimitive
 {
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
+    PlanPrimType type;
+    int   x1, y1, x2, y2;   // circle/disc: centre (x1, y1), radius x2
+                            // polygon: first index x1, vertex count x2
+    float r, g, b;
+};
 
-    GLfloat lightPos[] = { 0.0f, ROOM_HEIGHT - 0.1f, -2.0f, 1.0f };
-    GLfloat amb[]      = { 0.25f, 0.25f, 0.30f, 1.0f };
-    GLfloat diff[]     = { 0.9f, 0.9f, 0.9f, 1.0f };
-    GLfloat spec[]     = { 1.0f, 1.0f, 1.0f, 1.0f };
+std::vector<PlanPrimitive> planPrims;
+std::vector<int>           planPolyVerts;   // x, y pairs for polygon fills
+float planR = 1.0f, planG = 1.0f, planB = 1.0f;
 
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
-    glLightfv(GL_LIGHT0, GL_AMBIENT,  amb);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE,  diff);
-    glLightfv(GL_LIGHT0, GL_SPECULAR, spec);
+void planColor(float r, float g, float b)
+{
+    planR = r; planG = g; planB = b;
+}
 
-    glEnable(GL_COLOR_MATERIAL);
-    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
-    glShadeModel(GL_SMOOTH);
+void planLine(int x1, int y1, int x2, int y2)
+{
+    PlanPrimitive p = { PLAN_LINE, x1, y1, x2, y2, planR, planG, planB };
+    planPrims.push_back(p);
 }
 
-// --------------------------------------------------
-// DISPLAY
-// --------------------------------------------------
-void display()
+void planCircle(int xc, int yc, int r)
 {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    PlanPrimitive p = { PLAN_CIRCLE, xc, yc, r, 0, planR, planG, planB };
+    planPrims.push_back(p);
+}
 
-    if (!is3DMode)
-    {
-        // 2D MODE
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_LIGHTING);
+void planRectFill(int x1, int y1, int x2, int y2)
+{
+    PlanPrimitive p = { PLAN_RECT_FILL, x1, y1, x2, y2, planR, planG, planB };
+    planPrims.push_back(p);
+}
 
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        gluOrtho2D(0, gWindowWidth, 0, gWindowHeight);
+void planDiscFill(int xc, int yc, int r)
+{
+    PlanPrimitive p = { PLAN_DISC_FILL, xc, yc, r, 0, planR, planG, planB };
+    planPrims.push_back(p);
+}
 
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+void planPolygonFill(const int* xy, int count)
+{
+    PlanPrimitive p = { PLAN_POLYGON_FILL, (int)planPolyVerts.size(), 0, count, 0, planR, planG, planB };
+    planPolyVerts.insert(planPolyVerts.end(), xy, xy + 2 * count);
+    planPrims.push_back(p);
+}
 
-        drawOfficePlan2D();
-    }
-    else
-    {
-        // 3D MODE
-        glEnable(GL_DEPTH_TEST);
-        setupLighting();
+// Furniture dragged in the plan, as offsets in plan pixels. The 3D
+// objects, pick shapes and crowd goals follow (applyFurnitureMoves).
+enum PlanFurniture { PLAN_TABLE, PLAN_DESK, PLAN_CHAIR, PLAN_FURNITURE_COUNT };
 
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        double aspect = (double)gWindowWidth / (double)gWindowHeight;
-        gluPerspective(60.0, aspect, 0.1, 100.0);
+int planMoveX[PLAN_FURNITURE_COUNT] = {};
+int planMoveY[PLAN_FURNITURE_COUNT] = {};
 
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+// Plan layout before any furniture move, in plan pixels; the plan pick
+// shapes are built from the same numbers (definePickObjects)
+struct PlanRect { int x1, y1, x2, y2; };
 
-        // Camera direction from yaw/pitch
-        const float DEG2RAD = 3.1415926f / 180.0f;
-        float yawRad   = camYawDeg   * DEG2RAD;
-        float pitchRad = camPitchDeg * DEG2RAD;
+const int      PLAN_ROOM_MIN_X = 100, PLAN_ROOM_MAX_X = 900;
+const int      PLAN_ROOM_MIN_Y = 100, PLAN_ROOM_MAX_Y = 700;   // plan +y = world -z
+const int      PLAN_TABLE_X = 500, PLAN_TABLE_Y = 420, PLAN_TABLE_R = 120;
+const PlanRect PLAN_DESK_RECT  = { 220, 450, 420, 520 };
+const PlanRect PLAN_CHAIR_RECT = { 440, 450, 490, 500 };
+const PlanRect PLAN_DOOR_RECT  = { 440, PLAN_ROOM_MIN_Y, 560, PLAN_ROOM_MIN_Y + 60 };   // jambs at x1, x2
+const PlanRect PLAN_WINDOW_RECTS[2] = {
+    { 150, PLAN_ROOM_MAX_Y, 300, PLAN_ROOM_MAX_Y },
+    { 700, PLAN_ROOM_MAX_Y, 850, PLAN_ROOM_MAX_Y },
+};
 
-        float dirX = std::cos(pitchRad) * std::sin(yawRad);
-        float dirY = std::sin(pitchRad);
-        float dirZ = std::cos(pitchRad) * std::cos(yawRad);
+void planRectOutline(const PlanRect& r, int dx, int dy)
+{
+    int x1 = r.x1 + dx, y1 = r.y1 + dy, x2 = r.x2 + dx, y2 = r.y2 + dy;
+    planLine(x1, y1, x2, y1);
+    planLine(x2, y1, x2, y2);
+    planLine(x2, y2, x1, y2);
+    planLine(x1, y2, x1, y1);
+}
 
-        gluLookAt(camX, camY, camZ,
-                  camX + dirX, camY + dirY, camZ + dirZ,
-                  0.0f, 1.0f, 0.0f);
+// Which plan state drawPlanView last built planPrims for (planStateHash
+// with its framing scale); any other build resets it to 0
+uint64_t planPrimsState = 0;
 
-        drawRoomAndObjects3D();
-    }
+void buildOfficePlan2D()
+{
+    planPrimsState = 0;
+    planPrims.clear();
+    planPolyVerts.clear();
 
-    glutSwapBuffers();
-}
+    int left   = PLAN_ROOM_MIN_X;
+    int right  = PLAN_ROOM_MAX_X;
+    int bottom = PLAN_ROOM_MIN_Y;
+    int top    = PLAN_ROOM_MAX_Y;
 
-// --------------------------------------------------
-// KEYBOARD (PRESS)
-// --------------------------------------------------
-void keyboard(unsigned char key, int, int)
-{
-    switch (key)
+    // Floor and furniture footprints, under the outlines
+    if (showFootprints2D)
     {
-    case 27: // ESC
-        std::exit(0);
+        int floorPoly[] = { left, bottom, right, bottom, right, top, left, top };
+        planColor(0.09f, 0.09f, 0.14f);
+        planPolygonFill(floorPoly, 4);
+
+        if (showTable2D)
+        {
+            planColor(0.30f, 0.24f, 0.0f);
+            planDiscFill(PLAN_TABLE_X + planMoveX[PLAN_TABLE], PLAN_TABLE_Y + planMoveY[PLAN_TABLE], PLAN_TABLE_R);
+        }
+        planColor(0.30f, 0.15f, 0.0f);
+        planRectFill(PLAN_DESK_RECT.x1 + planMoveX[PLAN_DESK], PLAN_DESK_RECT.y1 + planMoveY[PLAN_DESK],
+                     PLAN_DESK_RECT.x2 + planMoveX[PLAN_DESK], PLAN_DESK_RECT.y2 + planMoveY[PLAN_DESK]);
+        planColor(0.0f, 0.21f, 0.30f);
+        planRectFill(PLAN_CHAIR_RECT.x1 + planMoveX[PLAN_CHAIR], PLAN_CHAIR_RECT.y1 + planMoveY[PLAN_CHAIR],
+                     PLAN_CHAIR_RECT.x2 + planMoveX[PLAN_CHAIR], PLAN_CHAIR_RECT.y2 + planMoveY[PLAN_CHAIR]);
+    }
+
+    // Room outline
+    planColor(1.0f, 1.0f, 1.0f);
+    planLine(left, bottom, right, bottom);
+    planLine(right, bottom, right, top);
+    planLine(right, top, left, top);
+    planLine(left, top, left, bottom);
+
+    // Round table (center)
+    if (showTable2D)
+    {
+        planColor(1.0f, 0.8f, 0.0f);
+        planCircle(PLAN_TABLE_X + planMoveX[PLAN_TABLE], PLAN_TABLE_Y + planMoveY[PLAN_TABLE], PLAN_TABLE_R);
+    }
+
+    // Desk (left)
+    planColor(1.0f, 0.5f, 0.0f);
+    planRectOutline(PLAN_DESK_RECT, planMoveX[PLAN_DESK], planMoveY[PLAN_DESK]);
+
+    // Chair
+    planColor(0.0f, 0.7f, 1.0f);
+    planRectOutline(PLAN_CHAIR_RECT, planMoveX[PLAN_CHAIR], planMoveY[PLAN_CHAIR]);
+
+    // Door (bottom)
+    if (showDoor2D)
+    {
+        const PlanRect& d = PLAN_DOOR_RECT;
+        planColor(0.0f, 1.0f, 0.0f);
+        planLine(d.x1, d.y1, d.x1, d.y2);
+        planLine(d.x2, d.y1, d.x2, d.y2);
+    }
+
+    // Windows (top)
+    if (showWindows2D)
+    {
+        planColor(0.2f, 0.8f, 1.0f);
+        for (int w = 0; w < 2; ++w)
+            planLine(PLAN_WINDOW_RECTS[w].x1, PLAN_WINDOW_RECTS[w].y1, PLAN_WINDOW_RECTS[w].x2, PLAN_WINDOW_RECTS[w].y2);
+    }
+}
+
+void rasterPlanPrimitives(const PlanTile& t, RasterScratch& scratch, const std::vector<PlanPrimitive>& prims,
+                          const std::vector<int>& polyVerts)
+{
+    for (size_t i = 0; i < prims.size(); ++i)
+    {
+        const PlanPrimitive& p = prims[i];
+        uint32_t c = packColor(p.r, p.g, p.b);
+        switch (p.type)
+        {
+        case PLAN_LINE:         rasterLine(t, p.x1, p.y1, p.x2, p.y2, c);       break;
+        case PLAN_CIRCLE:       rasterCircle(t, p.x1, p.y1, p.x2, c);           break;
+        case PLAN_RECT_FILL:    rasterRectFill(t, p.x1, p.y1, p.x2, p.y2, c);   break;
+        case PLAN_DISC_FILL:    rasterDiscFill(t, scratch, p.x1, p.y1, p.x2, c);         break;
+        case PLAN_POLYGON_FILL: rasterPolygonFill(t, scratch, &polyVerts[p.x1], p.x2, c); break;
+        }
+    }
+}
+
+void rasterPlanTile(const PlanTile& t, RasterScratch& scratch, const std::vector<PlanPrimitive>& prims,
+                    const std::vector<int>& polyVerts)
+{
+    uint32_t background = packColor(CLEAR_R, CLEAR_G, CLEAR_B);
+    for (int y = 0; y < t.h; ++y)
+        fillSpan(t.pixels + (ptrdiff_t)y * t.stride, t.w, background);
+
+    rasterPlanPrimitives(t, scratch, prims, polyVerts);
+}
+
+// Kernel scratch for rasterizing on the main thread
+RasterScratch planRasterScratch;
+
+// Window-sized plan buffer; re-rasterized only when the primitives or the
+// window size change, then blitted in one glDrawPixels call.
+std::vector<uint32_t>      planBuffer;
+std::vector<PlanPrimitive> planBufferPrims;
+std::vector<int>           planBufferVerts;
+int planBufferW = 0, planBufferH = 0;
+
+bool samePlanPrims(const std::vector<PlanPrimitive>& a, const std::vector<PlanPrimitive>& b)
+{
+    return a.size() == b.size() &&
+           (a.empty() || std::memcmp(&a[0], &b[0], a.size() * sizeof(PlanPrimitive)) == 0);
+}
+
+uint64_t hashPlanPrims(const std::vector<PlanPrimitive>& prims, const std::vector<int>& verts)
+{
+    uint64_t h = HASH_SEED;
+    if (!prims.empty()) h = hashBytes(&prims[0], prims.size() * sizeof(PlanPrimitive), h);
+    if (!verts.empty()) h = hashBytes(&verts[0], verts.size() * sizeof(int), h);
+    return h;
+}
+
+// Non-background runs of a rasterized plan. The scene cache stores the
+// startup plan this way so the first 2D frame is a few span fills.
+struct PlanSpan
+{
+    uint16_t y, x, length, pad;
+    uint32_t color;
+};
+
+const PlanSpan* planCacheSpans     = nullptr;
+size_t          planCacheSpanCount = 0;
+uint64_t        planCacheHash      = 0;     // hashPlanPrims of the spans' plan
+int             planCacheW = 0, planCacheH = 0;
+
+void encodePlanSpans(const std::vector<uint32_t>& pixels, int w, int h, std::vector<PlanSpan>& out)
+{
+    uint32_t background = packColor(CLEAR_R, CLEAR_G, CLEAR_B);
+    out.clear();
+    for (int y = 0; y < h; ++y)
+    {
+        const uint32_t* row = &pixels[(size_t)y * w];
+        for (int x = 0; x < w; )
+        {
+            int end = x + 1;
+            while (end < w && row[end] == row[x]) ++end;
+            if (row[x] != background)
+            {
+                PlanSpan s = { (uint16_t)y, (uint16_t)x, (uint16_t)(end - x), 0, row[x] };
+                out.push_back(s);
+            }
+            x = end;
+        }
+    }
+}
+
+void decodePlanSpans(const PlanTile& t, const PlanSpan* spans, size_t count)
+{
+    uint32_t background = packColor(CLEAR_R, CLEAR_G, CLEAR_B);
+    for (int y = 0; y < t.h; ++y)
+        fillSpan(t.pixels + (ptrdiff_t)y * t.stride, t.w, background);
+
+    // Spans come straight from the mapped cache; one that leaves the tile
+    // (a corrupt file) is dropped here rather than checked at map time
+    for (size_t i = 0; i < count; ++i)
+    {
+        const PlanSpan& sp = spans[i];
+        if (sp.y >= t.h || sp.x + sp.length > t.w) continue;
+        fillSpan(t.pixels + (ptrdiff_t)sp.y * t.stride + sp.x, sp.length, sp.color);
+    }
+}
+
+void updatePlanBuffer(int w, int h)
+{
+    if (w != planBufferW || h != planBufferH ||
+        !samePlanPrims(planPrims, planBufferPrims) || planPolyVerts != planBufferVerts)
+    {
+        planBuffer.resize((size_t)w * h);
+        PlanTile t = { &planBuffer[0], w, 0, 0, w, h };
+        if (planCacheSpans && w == planCacheW && h == planCacheH &&
+            hashPlanPrims(planPrims, planPolyVerts) == planCacheHash)
+            decodePlanSpans(t, planCacheSpans, planCacheSpanCount);
+        else
+            rasterPlanTile(t, planRasterScratch, planPrims, planPolyVerts);
+
+        planBufferPrims = planPrims;
+        planBufferVerts = planPolyVerts;
+        planBufferW = w;
+        planBufferH = h;
+    }
+}
+
+// Draws the primitives from the last buildOfficePlan2D() (plus overlays)
+// as a w x h image with its corner at (x, y)
+void drawOfficePlan2D(int x, int y, int w, int h)
+{
+    updatePlanBuffer(w, h);
+
+    ++frameStats.drawCalls;
+    glRasterPos2i(x, y);
+    glDrawPixels(w, h, GL_RGBA, GL_UNSIGNED_BYTE, &planBuffer[0]);
+}
+
+// --------------------------------------------------
+// 3D SCENE LAYOUT (objects + parts)
+// --------------------------------------------------
+// The 3D office as data: every object is a list of box / cylinder / quad
+// parts in the object's own space. The tables are tessellated once into
+// the scene mesh, and their bytes key the on-disk scene cache.
+enum PartShape  { PART_BOX, PART_CYLINDER, PART_QUAD };
+enum ObjectAnim { ANIM_NONE, ANIM_DOOR, ANIM_FAN };
+
+struct LayoutObject
+{
+    const char* name;
+    float       x, y, z;     // origin; animated objects rotate about Y here
+    ObjectAnim  anim;
+    bool        occluder;    // large and solid: rasterized for occlusion culling
+};
+
+// Transform is translate * rotY * rotX * scale. Boxes are unit cubes and
+// quads unit squares in XY facing +Z; cylinders are radius x height
+// (axis Y) before the scale.
+struct LayoutPart
+{
+    int       object;
+    PartShape shape;
+    int       segments;
+    float     radius, height;
+    float     r, g, b;
+    float     tx, ty, tz;
+    float     rotYDeg, rotXDeg;
+    float     sx, sy, sz;
+};
+
+const float DOOR_WIDTH  = 3.0f;
+const float DOOR_HEIGHT = 2.2f;
+const float DOOR_THICK  = 0.08f;
+
+enum
+{
+    OBJ_ROOM, OBJ_TABLE, OBJ_DESK, OBJ_CHAIR, OBJ_PERSON, OBJ_CABINET,
+    OBJ_WHITEBOARD, OBJ_MONITOR, OBJ_KEYBOARD, OBJ_LAMP, OBJ_PLANT,
+    OBJ_DOOR, OBJ_DOOR_HANDLE, OBJ_FAN, LAYOUT_OBJECT_COUNT
+};
+
+const LayoutObject layoutObjects[LAYOUT_OBJECT_COUNT] = {
+    { "Room",          0.0f, 0.0f, 0.0f, ANIM_NONE, true  },
+    { "Meeting table", 0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    { "Desk",          0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    { "Chair",         0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    { "Person",       -1.5f, 0.0f, -1.0f, ANIM_NONE, false },   // on the chair
+    { "Cabinet",       0.0f, 0.0f, 0.0f, ANIM_NONE, true  },
+    { "Whiteboard",    0.0f, 0.0f, 0.0f, ANIM_NONE, true  },
+    { "Monitor",       0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    { "Keyboard",      0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    { "Table lamp",    0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    { "Plant",         0.0f, 0.0f, 0.0f, ANIM_NONE, false },
+    // Hinge at x=-1.5 on the front wall; the handle swings about its own line
+    { "Door",         -1.5f, 0.0f, ROOM_HALF_DEPTH + 0.01f, ANIM_DOOR, true  },
+    { "Door handle",  -1.5f, 0.0f, ROOM_HALF_DEPTH + 0.12f, ANIM_DOOR, false },
+    { "Ceiling fan",   0.0f, 0.0f, 0.0f, ANIM_FAN, false },
+};
+
+// Shorthands for the parts table
+const float RW = ROOM_HALF_WIDTH, RD = ROOM_HALF_DEPTH, RH = ROOM_HEIGHT;
+
+const LayoutPart layoutParts[] = {
+    // object        shape      seg  radius height  color                 translate                          rotY    rotX    scale
+    // Floor, ceiling, light panels, walls (inside facing)
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.12f, 0.12f, 0.16f,  0.0f, 0.0f, 0.0f,                  0.0f, -90.0f,  2 * RW, 2 * RD, 1.0f },
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.20f, 0.20f, 0.25f,  0.0f, RH, 0.0f,                    0.0f,  90.0f,  2 * RW, 2 * RD, 1.0f },
+    { OBJ_ROOM,      PART_BOX,    0, 0, 0,       0.95f, 0.95f, 1.0f,  -1.5f, RH - 0.02f, -1.0f,           0.0f,   0.0f,  3.0f, 0.05f, 0.8f },
+    { OBJ_ROOM,      PART_BOX,    0, 0, 0,       0.95f, 0.95f, 1.0f,   1.5f, RH - 0.02f, -1.0f,           0.0f,   0.0f,  3.0f, 0.05f, 0.8f },
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.80f, 0.80f, 0.86f,  0.0f, RH * 0.5f, -RD,              0.0f,   0.0f,  2 * RW, RH, 1.0f },
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.80f, 0.80f, 0.86f, (-RW - 1.5f) * 0.5f, RH * 0.5f, RD, 180.0f, 0.0f,  RW - 1.5f, RH, 1.0f },
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.80f, 0.80f, 0.86f,  (RW + 1.5f) * 0.5f, RH * 0.5f, RD, 180.0f, 0.0f,  RW - 1.5f, RH, 1.0f },
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.80f, 0.80f, 0.86f, -RW, RH * 0.5f, 0.0f,               90.0f,  0.0f,  2 * RD, RH, 1.0f },
+    { OBJ_ROOM,      PART_QUAD,   0, 0, 0,       0.80f, 0.80f, 0.86f,  RW, RH * 0.5f, 0.0f,              -90.0f,  0.0f,  2 * RD, RH, 1.0f },
+
+    { OBJ_TABLE,     PART_CYLINDER, 40, 1.5f, 1.0f, 1.0f, 0.8f, 0.2f,   0.0f, 0.75f, 0.0f,                 0.0f,   0.0f,  1.0f, 0.5f, 1.0f },
+
+    // Desk top + two legs
+    { OBJ_DESK,      PART_BOX,    0, 0, 0,       0.90f, 0.55f, 0.25f, -3.5f, 0.8f, -1.2f,                 0.0f,   0.0f,  2.6f, 0.2f, 1.2f },
+    { OBJ_DESK,      PART_BOX,    0, 0, 0,       0.4f, 0.25f, 0.18f,  -4.6f, 0.4f, -1.8f,                 0.0f,   0.0f,  0.1f, 0.8f, 0.1f },
+    { OBJ_DESK,      PART_BOX,    0, 0, 0,       0.4f, 0.25f, 0.18f,  -2.4f, 0.4f, -1.8f,                 0.0f,   0.0f,  0.1f, 0.8f, 0.1f },
+
+    // Chair seat + backrest
+    { OBJ_CHAIR,     PART_BOX,    0, 0, 0,       0.2f, 0.6f, 1.0f,    -1.5f, 0.5f, -1.0f,                 0.0f,   0.0f,  0.9f, 0.18f, 0.9f },
+    { OBJ_CHAIR,     PART_BOX,    0, 0, 0,       0.2f, 0.6f, 1.0f,    -1.5f, 1.0f, -1.6f,                 0.0f,   0.0f,  0.9f, 0.7f, 0.15f },
+
+    // Seated person: legs, torso, head, arms reaching to the keyboard
+    { OBJ_PERSON,    PART_BOX,    0, 0, 0,       0.1f, 0.1f, 0.3f,    -0.18f, 0.4f, 0.1f,                 0.0f,   0.0f,  0.12f, 0.8f, 0.12f },
+    { OBJ_PERSON,    PART_BOX,    0, 0, 0,       0.1f, 0.1f, 0.3f,     0.18f, 0.4f, 0.1f,                 0.0f,   0.0f,  0.12f, 0.8f, 0.12f },
+    { OBJ_PERSON,    PART_BOX,    0, 0, 0,       0.0f, 0.4f, 0.8f,     0.0f, 0.9f, -0.05f,                0.0f,   0.0f,  0.45f, 0.7f, 0.25f },
+    { OBJ_PERSON,    PART_BOX,    0, 0, 0,       1.0f, 0.8f, 0.6f,     0.0f, 1.4f, -0.05f,                0.0f,   0.0f,  0.30f, 0.35f, 0.30f },
+    { OBJ_PERSON,    PART_BOX,    0, 0, 0,       0.0f, 0.4f, 0.8f,    -0.32f, 0.95f, -0.25f,              0.0f, -20.0f,  0.12f, 0.4f, 0.12f },
+    { OBJ_PERSON,    PART_BOX,    0, 0, 0,       0.0f, 0.4f, 0.8f,     0.32f, 0.95f, -0.25f,              0.0f, -15.0f,  0.12f, 0.4f, 0.12f },
+
+    { OBJ_CABINET,   PART_BOX,    0, 0, 0,       0.7f, 0.7f, 0.75f,    RW - 1.0f, 1.1f, -RD + 2.0f,       0.0f,   0.0f,  1.0f, 2.2f, 0.7f },
+    { OBJ_WHITEBOARD, PART_BOX,   0, 0, 0,       0.95f, 0.95f, 1.0f,   0.0f, 1.6f, -RD + 0.02f,           0.0f,   0.0f,  3.0f, 1.4f, 0.05f },
+
+    // Monitor screen + stand, keyboard
+    { OBJ_MONITOR,   PART_BOX,    0, 0, 0,       0.05f, 0.05f, 0.05f, -3.4f, 1.15f, -1.2f,                0.0f,   0.0f,  0.9f, 0.6f, 0.1f },
+    { OBJ_MONITOR,   PART_BOX,    0, 0, 0,       0.05f, 0.05f, 0.05f, -3.4f, 0.95f, -1.25f,               0.0f,   0.0f,  0.1f, 0.4f, 0.1f },
+    { OBJ_KEYBOARD,  PART_BOX,    0, 0, 0,       0.15f, 0.15f, 0.18f, -2.9f, 0.9f, -1.2f,                 0.0f,   0.0f,  0.9f, 0.05f, 0.25f },
+
+    // Table lamp: base, neck, shade (warm light)
+    { OBJ_LAMP,      PART_CYLINDER, 20, 0.12f, 0.08f, 0.3f, 0.2f, 0.1f,  -3.0f, 0.9f, -0.9f,             0.0f,   0.0f,  1.0f, 0.3f, 1.0f },
+    { OBJ_LAMP,      PART_CYLINDER, 16, 0.05f, 0.35f, 0.7f, 0.7f, 0.7f,  -3.0f, 1.05f, -0.9f,            0.0f,   0.0f,  1.0f, 1.0f, 1.0f },
+    { OBJ_LAMP,      PART_CYLINDER, 24, 0.18f, 0.30f, 1.0f, 0.95f, 0.75f, -3.0f, 1.3f, -0.9f,            0.0f,   0.0f,  1.0f, 1.0f, 1.0f },
+
+    // Plant (front-left corner): pot + leaves
+    { OBJ_PLANT,     PART_CYLINDER, 24, 0.3f, 0.6f, 0.6f, 0.3f, 0.15f,   -RW + 1.0f, 0.4f, RD - 1.0f,    0.0f,   0.0f,  1.0f, 0.8f, 1.0f },
+    { OBJ_PLANT,     PART_BOX,    0, 0, 0,       0.1f, 0.6f, 0.2f,    -RW + 1.0f, 1.1f, RD - 1.0f,        0.0f,   0.0f,  0.6f, 1.0f, 0.6f },
+
+    // Door panel with the hinge at its left edge, handle
+    { OBJ_DOOR,      PART_BOX,    0, 0, 0,       0.95f, 0.95f, 0.98f,  DOOR_WIDTH * 0.5f, DOOR_HEIGHT * 0.5f, 0.0f, 0.0f, 0.0f, DOOR_WIDTH, DOOR_HEIGHT, DOOR_THICK },
+    { OBJ_DOOR_HANDLE, PART_BOX,  0, 0, 0,       0.9f, 0.75f, 0.25f,   0.9f, DOOR_HEIGHT * 0.7f, 0.15f,   0.0f,   0.0f,  0.25f, 0.12f, 0.12f },
+
+    // Ceiling fan: hub + four blades
+    { OBJ_FAN,       PART_BOX,    0, 0, 0,       0.85f, 0.85f, 0.85f,  0.0f, RH - 0.2f, 0.0f,             0.0f,   0.0f,  0.3f, 0.1f, 0.3f },
+    { OBJ_FAN,       PART_BOX,    0, 0, 0,       0.9f, 0.9f, 0.9f,     1.4f, RH - 0.25f, 0.0f,            0.0f,   0.0f,  2.8f, 0.05f, 0.3f },
+    { OBJ_FAN,       PART_BOX,    0, 0, 0,       0.9f, 0.9f, 0.9f,     0.0f, RH - 0.25f, -1.4f,          90.0f,   0.0f,  2.8f, 0.05f, 0.3f },
+    { OBJ_FAN,       PART_BOX,    0, 0, 0,       0.9f, 0.9f, 0.9f,    -1.4f, RH - 0.25f, 0.0f,          180.0f,   0.0f,  2.8f, 0.05f, 0.3f },
+    { OBJ_FAN,       PART_BOX,    0, 0, 0,       0.9f, 0.9f, 0.9f,     0.0f, RH - 0.25f, 1.4f,          270.0f,   0.0f,  2.8f, 0.05f, 0.3f },
+};
+
+const int LAYOUT_PART_COUNT = (int)(sizeof(layoutParts) / sizeof(layoutParts[0]));
+
+// --------------------------------------------------
+// SCENE MESH (tessellated layout + instance table)
+// --------------------------------------------------
+// One interleaved vertex array and one index array for the whole scene.
+// Vertices are in object space; an instance is an object's index range
+// and origin, so a 3D frame is one glDrawElements per object. Normals get
+// the part's inverse-transpose without renormalizing, which is what the
+// fixed-function pipeline did with the glScalef blocks this replaced
+// (GL_NORMALIZE is off), so the lighting is unchanged.
+struct SceneVertex
+{
+    float    px, py, pz;
+    float    nx, ny, nz;
+    uint32_t color;         // packColor
+};
+
+struct SceneInstance
+{
+    float    x, y, z;
+    int32_t  anim;          // ObjectAnim
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    uint32_t occluder;
+    float    boundsMin[3];  // object space
+    float    boundsMax[3];
+};
+
+// What the renderer reads: the stores below, or a mapped scene cache
+const SceneVertex*   sceneVertices  = nullptr;
+const uint32_t*      sceneIndices   = nullptr;
+const SceneInstance* sceneInstances = nullptr;
+size_t sceneVertexCount = 0, sceneIndexCount = 0, sceneInstanceCount = 0;
+
+std::vector<SceneVertex>   sceneVertexStore;
+std::vector<uint32_t>      sceneIndexStore;
+std::vector<SceneInstance> sceneInstanceStore;
+std::vector<unsigned char> sceneInstanceChecked;   // per instance: 0 unchecked, 1 valid, 2 bad
+
+struct PartFrame
+{
+    float    rot[3][3];     // rotY * rotX
+    float    t[3];
+    float    s[3];
+    uint32_t color;
+};
+
+PartFrame makePartFrame(const LayoutPart& p)
+{
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    float cy = std::cos(p.rotYDeg * DEG2RAD), sy = std::sin(p.rotYDeg * DEG2RAD);
+    float cx = std::cos(p.rotXDeg * DEG2RAD), sx = std::sin(p.rotXDeg * DEG2RAD);
+
+    PartFrame f = {
+        { {  cy, sy * sx, sy * cx },
+          { 0.0f,     cx,     -sx },
+          { -sy, cy * sx, cy * cx } },
+        { p.tx, p.ty, p.tz },
+        { p.sx, p.sy, p.sz },
+        packColor(p.r, p.g, p.b)
+    };
+    return f;
+}
+
+// Returns the new vertex's index
+uint32_t emitSceneVertex(std::vector<SceneVertex>& out, const PartFrame& f,
+                         float x, float y, float z, float nx, float ny, float nz)
+{
+    float p[3] = { x * f.s[0], y * f.s[1], z * f.s[2] };
+    float n[3] = { nx / f.s[0], ny / f.s[1], nz / f.s[2] };
+
+    SceneVertex v;
+    v.px = f.rot[0][0] * p[0] + f.rot[0][1] * p[1] + f.rot[0][2] * p[2] + f.t[0];
+    v.py = f.rot[1][0] * p[0] + f.rot[1][1] * p[1] + f.rot[1][2] * p[2] + f.t[1];
+    v.pz = f.rot[2][0] * p[0] + f.rot[2][1] * p[1] + f.rot[2][2] * p[2] + f.t[2];
+    v.nx = f.rot[0][0] * n[0] + f.rot[0][1] * n[1] + f.rot[0][2] * n[2];
+    v.ny = f.rot[1][0] * n[0] + f.rot[1][1] * n[1] + f.rot[1][2] * n[2];
+    v.nz = f.rot[2][0] * n[0] + f.rot[2][1] * n[1] + f.rot[2][2] * n[2];
+    v.color = f.color;
+
+    out.push_back(v);
+    return (uint32_t)out.size() - 1;
+}
+
+void emitSceneTriangle(std::vector<uint32_t>& out, uint32_t a, uint32_t b, uint32_t c)
+{
+    out.push_back(a);
+    out.push_back(b);
+    out.push_back(c);
+}
+
+// Unit cube centered at origin (1x1x1)
+void tessellateBox(std::vector<SceneVertex>& verts, std::vector<uint32_t>& indices,
+                   const PartFrame& f)
+{
+    // Normal, then the four corners of each face
+    static const float faces[6][15] = {
+        {  0,  1,  0,  -0.5f,  0.5f, -0.5f,   0.5f,  0.5f, -0.5f,   0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f },  // top
+        {  0, -1,  0,  -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.5f, -0.5f, -0.5f },  // bottom
+        {  0,  0,  1,  -0.5f, -0.5f,  0.5f,   0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f },  // front
+        {  0,  0, -1,  -0.5f, -0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,   0.5f,  0.5f, -0.5f,   0.5f, -0.5f, -0.5f },  // back
+        { -1,  0,  0,  -0.5f, -0.5f, -0.5f,  -0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f },  // left
+        {  1,  0,  0,   0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,   0.5f,  0.5f,  0.5f,   0.5f, -0.5f,  0.5f },  // right
+    };
+
+    for (int i = 0; i < 6; ++i)
+    {
+        const float* q = faces[i];
+        uint32_t c[4];
+        for (int k = 0; k < 4; ++k)
+            c[k] = emitSceneVertex(verts, f, q[3 + 3 * k], q[4 + 3 * k], q[5 + 3 * k], q[0], q[1], q[2]);
+        emitSceneTriangle(indices, c[0], c[1], c[2]);
+        emitSceneTriangle(indices, c[0], c[2], c[3]);
+    }
+}
+
+// Side normals are (x, 0, z) at the rim, left unnormalized (see above)
+void tessellateCylinder(std::vector<SceneVertex>& verts, std::vector<uint32_t>& indices,
+                        const PartFrame& f, float radius, float height, int segments)
+{
+    float halfH = height * 0.5f;
+
+    uint32_t side = (uint32_t)verts.size();
+    for (int i = 0; i <= segments; ++i)
+    {
+        float theta = (2.0f * 3.1415926f * i) / segments;
+        float x = radius * std::cos(theta);
+        float z = radius * std::sin(theta);
+        emitSceneVertex(verts, f, x, -halfH, z, x, 0.0f, z);
+        emitSceneVertex(verts, f, x,  halfH, z, x, 0.0f, z);
+    }
+    for (int i = 0; i < segments; ++i)
+    {
+        uint32_t b0 = side + 2 * i, t0 = b0 + 1, b1 = b0 + 2, t1 = b0 + 3;
+        emitSceneTriangle(indices, b0, t0, t1);
+        emitSceneTriangle(indices, b0, t1, b1);
+    }
+
+    for (int cap = 0; cap < 2; ++cap)
+    {
+        float y  = cap == 0 ? halfH : -halfH;
+        float ny = cap == 0 ? 1.0f  : -1.0f;
+        uint32_t center = emitSceneVertex(verts, f, 0.0f, y, 0.0f, 0.0f, ny, 0.0f);
+        for (int i = 0; i <= segments; ++i)
+        {
+            float theta = (2.0f * 3.1415926f * i) / segments;
+            emitSceneVertex(verts, f, radius * std::cos(theta), y, radius * std::sin(theta), 0.0f, ny, 0.0f);
+        }
+        for (int i = 0; i < segments; ++i)
+            emitSceneTriangle(indices, center, center + 1 + i, center + 2 + i);
+    }
+}
+
+void tessellateQuad(std::vector<SceneVertex>& verts, std::vector<uint32_t>& indices,
+                    const PartFrame& f)
+{
+    uint32_t a = emitSceneVertex(verts, f, -0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f);
+    uint32_t b = emitSceneVertex(verts, f,  0.5f, -0.5f, 0.0f, 0.0f, 0.0f, 1.0f);
+    uint32_t c = emitSceneVertex(verts, f,  0.5f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f);
+    uint32_t d = emitSceneVertex(verts, f, -0.5f,  0.5f, 0.0f, 0.0f, 0.0f, 1.0f);
+    emitSceneTriangle(indices, a, b, c);
+    emitSceneTriangle(indices, a, c, d);
+}
+
+void tessellatePart(std::vector<SceneVertex>& verts, std::vector<uint32_t>& indices,
+                    const LayoutPart& p)
+{
+    PartFrame f = makePartFrame(p);
+    switch (p.shape)
+    {
+    case PART_BOX:      tessellateBox(verts, indices, f);                                  break;
+    case PART_CYLINDER: tessellateCylinder(verts, indices, f, p.radius, p.height, p.segments); break;
+    case PART_QUAD:     tessellateQuad(verts, indices, f);                                 break;
+    }
+}
+
+void useSceneStore()
+{
+    sceneVertices      = sceneVertexStore.empty()   ? nullptr : &sceneVertexStore[0];
+    sceneIndices       = sceneIndexStore.empty()    ? nullptr : &sceneIndexStore[0];
+    sceneInstances     = sceneInstanceStore.empty() ? nullptr : &sceneInstanceStore[0];
+    sceneVertexCount   = sceneVertexStore.size();
+    sceneIndexCount    = sceneIndexStore.size();
+    sceneInstanceCount = sceneInstanceStore.size();
+    sceneInstanceChecked.assign(sceneInstanceCount, 0);
+}
+
+// An instance's index range and indices, checked the first time it is
+// drawn or rasterized rather than when the cache is mapped, so startup
+// doesn't read the whole mesh. A bad one (corrupt cache) is skipped.
+bool sceneInstanceValid(size_t i)
+{
+    if (sceneInstanceChecked[i] == 0)
+    {
+        const SceneInstance& inst = sceneInstances[i];
+        bool ok = (uint64_t)inst.firstIndex + inst.indexCount <= sceneIndexCount;
+        for (uint32_t k = 0; k < inst.indexCount && ok; ++k)
+            ok = sceneIndices[inst.firstIndex + k] < sceneVertexCount;
+        sceneInstanceChecked[i] = ok ? 1 : 2;
+    }
+    return sceneInstanceChecked[i] == 1;
+}
+
+void buildSceneMesh()
+{
+    sceneVertexStore.clear();
+    sceneIndexStore.clear();
+    sceneInstanceStore.clear();
+
+    for (int o = 0; o < LAYOUT_OBJECT_COUNT; ++o)
+    {
+        const LayoutObject& lo = layoutObjects[o];
+        SceneInstance inst = { lo.x, lo.y, lo.z, (int32_t)lo.anim,
+                               (uint32_t)sceneIndexStore.size(), 0, lo.occluder ? 1u : 0u,
+                               { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+        size_t firstVertex = sceneVertexStore.size();
+
+        for (int i = 0; i < LAYOUT_PART_COUNT; ++i)
+        {
+            if (layoutParts[i].object == o)
+                tessellatePart(sceneVertexStore, sceneIndexStore, layoutParts[i]);
+        }
+
+        inst.indexCount = (uint32_t)sceneIndexStore.size() - inst.firstIndex;
+        for (size_t v = firstVertex; v < sceneVertexStore.size(); ++v)
+        {
+            const float p[3] = { sceneVertexStore[v].px, sceneVertexStore[v].py, sceneVertexStore[v].pz };
+            for (int k = 0; k < 3; ++k)
+            {
+                if (v == firstVertex || p[k] < inst.boundsMin[k]) inst.boundsMin[k] = p[k];
+                if (v == firstVertex || p[k] > inst.boundsMax[k]) inst.boundsMax[k] = p[k];
+            }
+        }
+        sceneInstanceStore.push_back(inst);
+    }
+    useSceneStore();
+}
+
+// --------------------------------------------------
+// CAMERA MATH (shared by display + picking)
+// --------------------------------------------------
+const float CAM_FOVY_DEG = 60.0f;
+
+void cameraForward(float& dirX, float& dirY, float& dirZ)
+{
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    float yawRad   = camYawDeg   * DEG2RAD;
+    float pitchRad = camPitchDeg * DEG2RAD;
+
+    dirX = std::cos(pitchRad) * std::sin(yawRad);
+    dirY = std::sin(pitchRad);
+    dirZ = std::cos(pitchRad) * std::cos(yawRad);
+}
+
+// Column-major 4x4, out = a * b (out may not alias a or b)
+void multiplyMatrix4(const float a[16], const float b[16], float out[16])
+{
+    for (int c = 0; c < 4; ++c)
+        for (int r = 0; r < 4; ++r)
+            out[c * 4 + r] = a[r] * b[c * 4] + a[4 + r] * b[c * 4 + 1] +
+                             a[8 + r] * b[c * 4 + 2] + a[12 + r] * b[c * 4 + 3];
+}
+
+// Same matrix renderScene builds with gluPerspective * gluLookAt
+void cameraViewProjection(double aspect, float out[16])
+{
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    const float zn = 0.1f, zf = 100.0f;
+    float f = 1.0f / std::tan(CAM_FOVY_DEG * 0.5f * DEG2RAD);
+    float proj[16] = { f / (float)aspect, 0, 0, 0,
+                       0, f, 0, 0,
+                       0, 0, (zf + zn) / (zn - zf), -1,
+                       0, 0, 2.0f * zf * zn / (zn - zf), 0 };
+
+    // lookAt basis: s = forward x up, u = s x forward
+    float fx, fy, fz;
+    cameraForward(fx, fy, fz);
+    float sx = -fz, sy = 0.0f, sz = fx;
+    float sl = std::sqrt(sx * sx + sz * sz);
+    if (sl > 0.0f) { sx /= sl; sz /= sl; }
+    float ux = sy * fz - sz * fy, uy = sz * fx - sx * fz, uz = sx * fy - sy * fx;
+    float view[16] = { sx, ux, -fx, 0,
+                       sy, uy, -fy, 0,
+                       sz, uz, -fz, 0,
+                       -(sx * camX + sy * camY + sz * camZ),
+                       -(ux * camX + uy * camY + uz * camZ),
+                        (fx * camX + fy * camY + fz * camZ), 1 };
+    multiplyMatrix4(proj, view, out);
+}
+
+// --------------------------------------------------
+// PICKING (CPU ray cast / plan point query over a BVH)
+// --------------------------------------------------
+struct AABB
+{
+    float minX, minY, minZ;
+    float maxX, maxY, maxZ;
+};
+
+enum PickShape { PICK_BOX, PICK_CYLINDER };
+
+// One selectable object. 3D shape is an oriented box (yaw about Y) or a
+// vertical cylinder (hx = radius); the plan shape is a rect or a circle
+// in 2D plan pixel space (phx = radius for circles).
+struct PickObject
+{
+    const char* name;
+    int         source;   // layoutObjects index, or LAYOUT_OBJECT_COUNT + plan-only index
+
+    bool      in3D;
+    PickShape shape3D;
+    float cx, cy, cz;
+    float hx, hy, hz;
+    float yawDeg;
+
+    bool      inPlan;
+    PickShape shape2D;
+    float px, py;
+    float phx, phy;
+};
+
+struct BvhNode
+{
+    AABB box;
+    int  first;   // leaf: first entry in bvh indices, inner: left child
+    int  count;   // leaf: number of objects, inner: 0 (right = left + 1)
+};
+
+struct Bvh
+{
+    std::vector<BvhNode> nodes;
+    std::vector<int>     indices;
+};
+
+std::vector<PickObject> pickObjects;
+std::vector<PickObject> pickObjectBase;   // before furniture moves (definePickObjects or the cache)
+std::vector<AABB>       pickBounds3D;
+Bvh  pickBvh3D;
+Bvh  pickBvh2D;
+int  selectedObject = -1;
+int  pickDoorIndex  = -1;
+
+const int BVH_LEAF_SIZE = 2;
+
+AABB boxBoundsXZ(float cx, float cy, float cz,
+                 float hx, float hy, float hz, float yawDeg)
+{
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    float c = std::fabs(std::cos(yawDeg * DEG2RAD));
+    float s = std::fabs(std::sin(yawDeg * DEG2RAD));
+    float ex = c * hx + s * hz;
+    float ez = s * hx + c * hz;
+    AABB b = { cx - ex, cy - hy, cz - ez, cx + ex, cy + hy, cz + ez };
+    return b;
+}
+
+void growBounds(AABB& a, const AABB& b)
+{
+    a.minX = std::min(a.minX, b.minX); a.maxX = std::max(a.maxX, b.maxX);
+    a.minY = std::min(a.minY, b.minY); a.maxY = std::max(a.maxY, b.maxY);
+    a.minZ = std::min(a.minZ, b.minZ); a.maxZ = std::max(a.maxZ, b.maxZ);
+}
+
+// The panel's center swings about the hinge, the door object's origin
+void updateDoorPickShape(PickObject& o, float angleDeg)
+{
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    const LayoutObject& hinge = layoutObjects[OBJ_DOOR];
+    float a = angleDeg * DEG2RAD;
+    o.cx = hinge.x + DOOR_WIDTH * 0.5f * std::cos(a);
+    o.cz = hinge.z - DOOR_WIDTH * 0.5f * std::sin(a);
+    o.yawDeg = angleDeg;
+}
+
+AABB pickObjectBounds3D(const PickObject& o)
+{
+    if (o.shape3D == PICK_CYLINDER)
+    {
+        AABB b = { o.cx - o.hx, o.cy - o.hy, o.cz - o.hx,
+                   o.cx + o.hx, o.cy + o.hy, o.cz + o.hx };
+        return b;
+    }
+    return boxBoundsXZ(o.cx, o.cy, o.cz, o.hx, o.hy, o.hz, o.yawDeg);
+}
+
+AABB pickObjectBounds2D(const PickObject& o)
+{
+    AABB b = { o.px - o.phx, o.py - o.phy, 0.0f,
+               o.px + o.phx, o.py + o.phy, 0.0f };
+    return b;
+}
+
+void buildBvhRange(Bvh& bvh, const std::vector<AABB>& bounds,
+                   int nodeIndex, int first, int count)
+{
+    AABB box = bounds[bvh.indices[first]];
+    AABB centroids = box;
+    for (int i = first; i < first + count; ++i)
+    {
+        const AABB& b = bounds[bvh.indices[i]];
+        growBounds(box, b);
+        AABB c = { (b.minX + b.maxX) * 0.5f, (b.minY + b.maxY) * 0.5f, (b.minZ + b.maxZ) * 0.5f,
+                   (b.minX + b.maxX) * 0.5f, (b.minY + b.maxY) * 0.5f, (b.minZ + b.maxZ) * 0.5f };
+        if (i == first) centroids = c;
+        else            growBounds(centroids, c);
+    }
+    bvh.nodes[nodeIndex].box = box;
+
+    if (count <= BVH_LEAF_SIZE)
+    {
+        bvh.nodes[nodeIndex].first = first;
+        bvh.nodes[nodeIndex].count = count;
+        return;
+    }
+
+    // Median split along the longest centroid axis
+    float ext[3] = { centroids.maxX - centroids.minX,
+                     centroids.maxY - centroids.minY,
+                     centroids.maxZ - centroids.minZ };
+    int axis = 0;
+    if (ext[1] > ext[axis]) axis = 1;
+    if (ext[2] > ext[axis]) axis = 2;
+
+    int mid = first + count / 2;
+    std::nth_element(bvh.indices.begin() + first,
+                     bvh.indices.begin() + mid,
+                     bvh.indices.begin() + first + count,
+                     [&](int a, int b)
+                     {
+                         const AABB& ba = bounds[a];
+                         const AABB& bb = bounds[b];
+                         if (axis == 0) return ba.minX + ba.maxX < bb.minX + bb.maxX;
+                         if (axis == 1) return ba.minY + ba.maxY < bb.minY + bb.maxY;
+                         return ba.minZ + ba.maxZ < bb.minZ + bb.maxZ;
+                     });
+
+    int left = (int)bvh.nodes.size();
+    bvh.nodes.push_back(BvhNode());
+    bvh.nodes.push_back(BvhNode());
+    bvh.nodes[nodeIndex].first = left;
+    bvh.nodes[nodeIndex].count = 0;
+
+    buildBvhRange(bvh, bounds, left,     first, mid - first);
+    buildBvhRange(bvh, bounds, left + 1, mid,   first + count - mid);
+}
+
+void buildBvh(Bvh& bvh, const std::vector<AABB>& bounds, const std::vector<int>& items)
+{
+    bvh.nodes.clear();
+    bvh.indices = items;
+    if (items.empty()) return;
+
+    bvh.nodes.reserve(items.size() * 2);
+    bvh.nodes.push_back(BvhNode());
+    buildBvhRange(bvh, bounds, 0, 0, (int)items.size());
+}
+
+// 3D pick shape of a layout object, from the same tessellated vertices as
+// the scene mesh so picking can't drift from the drawing. Boxes are the
+// vertex bounds; cylinders keep the bounds' height and take the largest
+// distance of any vertex from the vertical axis through the bounds' center
+// (the fan's hub, so the disc covers every blade angle).
+void addLayoutPickObject(int object, PickShape shape3D)
+{
+    std::vector<SceneVertex> verts;
+    std::vector<uint32_t>    indices;
+    for (int i = 0; i < LAYOUT_PART_COUNT; ++i)
+        if (layoutParts[i].object == object) tessellatePart(verts, indices, layoutParts[i]);
+
+    AABB b = { verts[0].px, verts[0].py, verts[0].pz, verts[0].px, verts[0].py, verts[0].pz };
+    for (size_t v = 1; v < verts.size(); ++v)
+    {
+        AABB p = { verts[v].px, verts[v].py, verts[v].pz, verts[v].px, verts[v].py, verts[v].pz };
+        growBounds(b, p);
+    }
+
+    const LayoutObject& lo = layoutObjects[object];
+    PickObject o = {};
+    o.name    = lo.name;
+    o.source  = object;
+    o.in3D    = true;
+    o.shape3D = shape3D;
+    o.cx = lo.x + (b.minX + b.maxX) * 0.5f;
+    o.cy = lo.y + (b.minY + b.maxY) * 0.5f;
+    o.cz = lo.z + (b.minZ + b.maxZ) * 0.5f;
+    o.hx = (b.maxX - b.minX) * 0.5f;
+    o.hy = (b.maxY - b.minY) * 0.5f;
+    o.hz = (b.maxZ - b.minZ) * 0.5f;
+    if (shape3D == PICK_CYLINDER)
+    {
+        float ax = (b.minX + b.maxX) * 0.5f, az = (b.minZ + b.maxZ) * 0.5f, r2 = 0.0f;
+        for (size_t v = 0; v < verts.size(); ++v)
+        {
+            float dx = verts[v].px - ax, dz = verts[v].pz - az;
+            r2 = std::max(r2, dx * dx + dz * dz);
+        }
+        o.hx = o.hz = std::sqrt(r2);
+    }
+    pickObjects.push_back(o);
+}
+
+// Selectable only in the plan; named by the index into PLAN_ONLY_PICK_NAMES
+const char* const PLAN_ONLY_PICK_NAMES[] = { "Left window", "Right window" };
+const int PLAN_ONLY_PICK_COUNT = (int)(sizeof(PLAN_ONLY_PICK_NAMES) / sizeof(PLAN_ONLY_PICK_NAMES[0]));
+
+const char* pickSourceName(int source)
+{
+    return source < LAYOUT_OBJECT_COUNT ? layoutObjects[source].name
+                                        : PLAN_ONLY_PICK_NAMES[source - LAYOUT_OBJECT_COUNT];
+}
+
+void addPlanOnlyObject(int planOnly)
+{
+    PickObject o = {};
+    o.source = LAYOUT_OBJECT_COUNT + planOnly;
+    o.name   = pickSourceName(o.source);
+    pickObjects.push_back(o);
+}
+
+void setPlanShape(PickShape shape2D, float px, float py, float phx, float phy)
+{
+    PickObject& o = pickObjects.back();
+    o.inPlan  = true;
+    o.shape2D = shape2D;
+    o.px = px; o.py = py; o.phx = phx; o.phy = phy;
+}
+
+// pad widens thin outlines (the windows) into something clickable
+void setPlanRect(const PlanRect& r, float pad)
+{
+    setPlanShape(PICK_BOX, (r.x1 + r.x2) * 0.5f, (r.y1 + r.y2) * 0.5f,
+                 (r.x2 - r.x1) * 0.5f + pad, (r.y2 - r.y1) * 0.5f + pad);
+}
+
+// 3D shapes from layoutParts, plan shapes from the PLAN_* footprints that
+// buildOfficePlan2D draws. Only run when the scene cache is rebuilt; a
+// mapped cache carries the result (pickObjectBase).
+void definePickObjects()
+{
+    pickObjects.clear();
+
+    addLayoutPickObject(OBJ_TABLE, PICK_CYLINDER);
+    setPlanShape(PICK_CYLINDER, (float)PLAN_TABLE_X, (float)PLAN_TABLE_Y, (float)PLAN_TABLE_R, (float)PLAN_TABLE_R);
+
+    addLayoutPickObject(OBJ_DESK, PICK_BOX);
+    setPlanRect(PLAN_DESK_RECT, 0.0f);
+
+    addLayoutPickObject(OBJ_CHAIR, PICK_BOX);
+    setPlanRect(PLAN_CHAIR_RECT, 0.0f);
+
+    addLayoutPickObject(OBJ_PERSON,   PICK_BOX);
+    addLayoutPickObject(OBJ_MONITOR,  PICK_BOX);
+    addLayoutPickObject(OBJ_KEYBOARD, PICK_BOX);
+    addLayoutPickObject(OBJ_LAMP,     PICK_CYLINDER);
+
+    addLayoutPickObject(OBJ_CABINET,    PICK_BOX);
+    addLayoutPickObject(OBJ_WHITEBOARD, PICK_BOX);
+
+    addLayoutPickObject(OBJ_PLANT, PICK_CYLINDER);
+    addLayoutPickObject(OBJ_FAN,   PICK_CYLINDER);
+
+    // The panel's own extent; updateDoorPickShape swings its center
+    addLayoutPickObject(OBJ_DOOR, PICK_BOX);
+    setPlanRect(PLAN_DOOR_RECT, 0.0f);
+    pickDoorIndex = (int)pickObjects.size() - 1;
+
+    for (int w = 0; w < PLAN_ONLY_PICK_COUNT; ++w)
+    {
+        addPlanOnlyObject(w);
+        setPlanRect(PLAN_WINDOW_RECTS[w], 6.0f);
+    }
+    pickObjectBase = pickObjects;
+}
+
+// Over the objects from definePickObjects()
+void buildPickingBvh()
+{
+    std::vector<AABB> bounds2D(pickObjects.size());
+    std::vector<int>  items3D, items2D;
+    pickBounds3D.assign(pickObjects.size(), AABB());
+
+    for (size_t i = 0; i < pickObjects.size(); ++i)
+    {
+        PickObject& o = pickObjects[i];
+        if ((int)i == pickDoorIndex)
+        {
+            // Conservative box over the whole swing so the tree never needs a refit
+            updateDoorPickShape(o, 0.0f);
+            pickBounds3D[i] = pickObjectBounds3D(o);
+            for (float a = 5.0f; a <= DOOR_MAX_ANGLE; a += 5.0f)
+            {
+                updateDoorPickShape(o, a);
+                growBounds(pickBounds3D[i], pickObjectBounds3D(o));
+            }
+            updateDoorPickShape(o, doorAngleDeg);
+        }
+        else
+        {
+            pickBounds3D[i] = pickObjectBounds3D(o);
+        }
+
+        if (o.in3D) items3D.push_back((int)i);
+        if (o.inPlan)
+        {
+            bounds2D[i] = pickObjectBounds2D(o);
+            items2D.push_back((int)i);
+        }
+    }
+
+    buildBvh(pickBvh3D, pickBounds3D, items3D);
+    buildBvh(pickBvh2D, bounds2D, items2D);
+}
+
+// Slab test; returns entry distance in tHit when the ray hits within (0, tMax)
+bool rayHitsAABB(const float o[3], const float invD[3], const AABB& b, float tMax, float& tHit)
+{
+    float t0 = 0.0f, t1 = tMax;
+    const float mins[3] = { b.minX, b.minY, b.minZ };
+    const float maxs[3] = { b.maxX, b.maxY, b.maxZ };
+    for (int a = 0; a < 3; ++a)
+    {
+        float tn = (mins[a] - o[a]) * invD[a];
+        float tf = (maxs[a] - o[a]) * invD[a];
+        if (tn > tf) std::swap(tn, tf);
+        if (tn > t0) t0 = tn;
+        if (tf < t1) t1 = tf;
+        if (t0 > t1) return false;
+    }
+    tHit = t0;
+    return true;
+}
+
+bool rayHitsPickObject(const PickObject& p, const float o[3], const float d[3], float tMax, float& tHit)
+{
+    float ox = o[0] - p.cx, oy = o[1] - p.cy, oz = o[2] - p.cz;
+
+    if (p.shape3D == PICK_CYLINDER)
+    {
+        // Side wall first, then the caps
+        float best = tMax;
+        bool  hit  = false;
+        float a = d[0] * d[0] + d[2] * d[2];
+        float b = ox * d[0] + oz * d[2];
+        float c = ox * ox + oz * oz - p.hx * p.hx;
+        if (a > 1e-8f)
+        {
+            float disc = b * b - a * c;
+            if (disc >= 0.0f)
+            {
+                float t = (-b - std::sqrt(disc)) / a;
+                if (t > 0.0f && t < best && std::fabs(oy + d[1] * t) <= p.hy)
+                {
+                    best = t; hit = true;
+                }
+            }
+        }
+        if (std::fabs(d[1]) > 1e-8f)
+        {
+            for (int s = -1; s <= 1; s += 2)
+            {
+                float t = (s * p.hy - oy) / d[1];
+                float x = ox + d[0] * t, z = oz + d[2] * t;
+                if (t > 0.0f && t < best && x * x + z * z <= p.hx * p.hx)
+                {
+                    best = t; hit = true;
+                }
+            }
+        }
+        tHit = best;
+        return hit;
+    }
+
+    // Oriented box: rotate the ray into the box frame
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    float c = std::cos(p.yawDeg * DEG2RAD);
+    float s = std::sin(p.yawDeg * DEG2RAD);
+    float lo[3] = { ox * c - oz * s, oy, ox * s + oz * c };
+    float ld[3] = { d[0] * c - d[2] * s, d[1], d[0] * s + d[2] * c };
+    float inv[3];
+    for (int a = 0; a < 3; ++a)
+        inv[a] = (std::fabs(ld[a]) > 1e-12f) ? 1.0f / ld[a] : 1e30f;
+
+    AABB local = { -p.hx, -p.hy, -p.hz, p.hx, p.hy, p.hz };
+    return rayHitsAABB(lo, inv, local, tMax, tHit);
+}
+
+// Nearest hit along the ray, or -1. Children are visited near-first so
+// far subtrees are rejected by the running tMax.
+int pickRay(const float origin[3], const float dir[3])
+{
+    if (pickBvh3D.nodes.empty()) return -1;
+
+    if (pickDoorIndex >= 0)
+        updateDoorPickShape(pickObjects[pickDoorIndex], doorAngleDeg);
+
+    float inv[3];
+    for (int a = 0; a < 3; ++a)
+        inv[a] = (std::fabs(dir[a]) > 1e-12f) ? 1.0f / dir[a] : 1e30f;
+
+    int   best = -1;
+    float tMax = 1e30f;
+    float tNode;
+
+    int stack[64];
+    int sp = 0;
+    if (!rayHitsAABB(origin, inv, pickBvh3D.nodes[0].box, tMax, tNode)) return -1;
+    stack[sp++] = 0;
+
+    while (sp > 0)
+    {
+        const BvhNode& n = pickBvh3D.nodes[stack[--sp]];
+        if (n.count > 0)
+        {
+            for (int i = n.first; i < n.first + n.count; ++i)
+            {
+                int id = pickBvh3D.indices[i];
+                float t;
+                if (rayHitsPickObject(pickObjects[id], origin, dir, tMax, t))
+                {
+                    tMax = t;
+                    best = id;
+                }
+            }
+            continue;
+        }
+
+        float tl, tr;
+        bool hl = rayHitsAABB(origin, inv, pickBvh3D.nodes[n.first].box,     tMax, tl);
+        bool hr = rayHitsAABB(origin, inv, pickBvh3D.nodes[n.first + 1].box, tMax, tr);
+        if (hl && hr)
+        {
+            // Push the far child first so the near one pops next
+            if (tl < tr) { stack[sp++] = n.first + 1; stack[sp++] = n.first; }
+            else         { stack[sp++] = n.first;     stack[sp++] = n.first + 1; }
+        }
+        else if (hl) stack[sp++] = n.first;
+        else if (hr) stack[sp++] = n.first + 1;
+    }
+    return best;
+}
+
+// Footprints overlap (the chair sits inside the table disc), so every
+// candidate is tested and the smallest one under the point wins
+int pickPlanPoint(float x, float y)
+{
+    if (pickBvh2D.nodes.empty()) return -1;
+
+    int   best     = -1;
+    float bestArea = 1e30f;
+    int stack[64];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0)
+    {
+        const BvhNode& n = pickBvh2D.nodes[stack[--sp]];
+        if (x < n.box.minX || x > n.box.maxX || y < n.box.minY || y > n.box.maxY)
+            continue;
+
+        if (n.count == 0)
+        {
+            stack[sp++] = n.first;
+            stack[sp++] = n.first + 1;
+            continue;
+        }
+
+        for (int i = n.first; i < n.first + n.count; ++i)
+        {
+            const PickObject& p = pickObjects[pickBvh2D.indices[i]];
+            float dx = x - p.px, dy = y - p.py;
+            bool  round  = (p.shape2D == PICK_CYLINDER);
+            bool  inside = round ? (dx * dx + dy * dy <= p.phx * p.phx)
+                                 : (std::fabs(dx) <= p.phx && std::fabs(dy) <= p.phy);
+            float area   = round ? 3.1415926f * p.phx * p.phx : 4.0f * p.phx * p.phy;
+            if (inside && area < bestArea)
+            {
+                best     = pickBvh2D.indices[i];
+                bestArea = area;
+            }
+        }
+    }
+    return best;
+}
+
+// Ray through pixel (mouseX, mouseY) (origin top-left) of a w x h
+// perspective view -> object index
+int pickPerspective(int mouseX, int mouseY, int w, int h)
+{
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    float aspect  = (float)w / (float)h;
+    float tanHalf = std::tan(CAM_FOVY_DEG * 0.5f * DEG2RAD);
+    float ndcX = 2.0f * (mouseX + 0.5f) / w - 1.0f;
+    float ndcY = 1.0f - 2.0f * (mouseY + 0.5f) / h;
+
+    // Same basis gluLookAt builds: forward f, side s = f x up, up u = s x f
+    float f[3];
+    cameraForward(f[0], f[1], f[2]);
+    float s[3] = { -f[2], 0.0f, f[0] };
+    float sLen = std::sqrt(s[0] * s[0] + s[2] * s[2]);
+    s[0] /= sLen; s[2] /= sLen;
+    float u[3] = { s[1] * f[2] - s[2] * f[1],
+                   s[2] * f[0] - s[0] * f[2],
+                   s[0] * f[1] - s[1] * f[0] };
+
+    float px = ndcX * aspect * tanHalf;
+    float py = ndcY * tanHalf;
+    float dir[3];
+    for (int a = 0; a < 3; ++a)
+        dir[a] = f[a] + s[a] * px + u[a] * py;
+
+    float origin[3] = { camX, camY, camZ };
+    return pickRay(origin, dir);
+}
+
+void addSelectionHighlight2D()
+{
+    if (selectedObject < 0 || !pickObjects[selectedObject].inPlan) return;
+
+    const PickObject& p = pickObjects[selectedObject];
+    int pad = 4;
+    int x1 = (int)(p.px - p.phx) - pad, x2 = (int)(p.px + p.phx) + pad;
+    int y1 = (int)(p.py - p.phy) - pad, y2 = (int)(p.py + p.phy) + pad;
+
+    planColor(1.0f, 0.2f, 0.8f);
+    planLine(x1, y1, x2, y1);
+    planLine(x2, y1, x2, y2);
+    planLine(x2, y2, x1, y2);
+    planLine(x1, y2, x1, y1);
+}
+
+void drawSelectionHighlight3D()
+{
+    if (selectedObject < 0 || !pickObjects[selectedObject].in3D) return;
+
+    const PickObject& p = pickObjects[selectedObject];
+    glDisable(GL_LIGHTING);
+    glColor3f(1.0f, 0.2f, 0.8f);
+    glPushMatrix();
+    glTranslatef(p.cx, p.cy, p.cz);
+    glRotatef(p.yawDeg, 0.0f, 1.0f, 0.0f);
+    if (p.shape3D == PICK_CYLINDER)
+        glScalef(2.0f * p.hx + 0.04f, 2.0f * p.hy + 0.04f, 2.0f * p.hx + 0.04f);
+    else
+        glScalef(2.0f * p.hx + 0.04f, 2.0f * p.hy + 0.04f, 2.0f * p.hz + 0.04f);
+    ++frameStats.drawCalls;
+    glutWireCube(1.0);
+    glPopMatrix();
+    glEnable(GL_LIGHTING);
+}
+
+// --------------------------------------------------
+// WORKER THREADS (shared job queue)
+// --------------------------------------------------
+std::vector<std::thread>          workerThreads;
+std::deque<std::function<void()>> workerJobs;
+std::mutex                        workerMutex;
+std::condition_variable           workerWake;   // job queued / quit
+std::condition_variable           workerDone;   // a job finished
+int  workerBusy = 0;
+bool workerQuit = false;
+
+// parallelFor's indices. There is one batch, reused by every call, so
+// dispatching allocates nothing; workers take its indices before queued
+// jobs because the caller is blocked on them.
+struct ForBatch
+{
+    void      (*call)(const void* fn, int i);
+    const void* fn;
+    int         count;
+    int         next;        // next index to hand out
+    int         remaining;   // not yet finished
+};
+
+ForBatch                workerBatch = {};
+std::condition_variable workerBatchDone;
+
+void workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        ForBatch batch;
+        int      index = -1;
+        {
+            std::unique_lock<std::mutex> lock(workerMutex);
+            workerWake.wait(lock, [] {
+                return workerQuit || workerBatch.next < workerBatch.count || !workerJobs.empty();
+            });
+            if (workerBatch.next < workerBatch.count)
+            {
+                batch = workerBatch;
+                index = workerBatch.next++;
+            }
+            else
+            {
+                if (workerJobs.empty()) return;
+                job = std::move(workerJobs.front());
+                workerJobs.pop_front();
+                ++workerBusy;
+            }
+        }
+
+        if (index >= 0)
+        {
+            batch.call(batch.fn, index);
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(workerMutex);
+                last = --workerBatch.remaining == 0;
+            }
+            if (last) workerBatchDone.notify_all();
+            continue;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(workerMutex);
+            --workerBusy;
+        }
+        workerDone.notify_all();
+    }
+}
+
+void stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        workerQuit = true;
+    }
+    workerWake.notify_all();
+    for (size_t i = 0; i < workerThreads.size(); ++i)
+        workerThreads[i].join();
+    workerThreads.clear();
+}
+
+void startWorkers()
+{
+    if (!workerThreads.empty()) return;
+
+    unsigned n = std::thread::hardware_concurrency();
+    if (n == 0) n = 2;
+    for (unsigned i = 0; i < n; ++i)
+        workerThreads.push_back(std::thread(workerLoop));
+
+    // Threads must be joined before static destructors run on std::exit()
+    std::atexit(stopWorkers);
+}
+
+void submitJob(std::function<void()> job)
+{
+    startWorkers();
+    {
+        std::lock_guard<std::mutex> lock(workerMutex);
+        workerJobs.push_back(std::move(job));
+    }
+    workerWake.notify_one();
+}
+
+// Blocks until at most maxPending jobs are queued or running
+void waitForJobs(int maxPending)
+{
+    std::unique_lock<std::mutex> lock(workerMutex);
+    workerDone.wait(lock, [&] { return (int)workerJobs.size() + workerBusy <= maxPending; });
+}
+
+// Runs fn(0..count-1) on the workers and blocks until every call returns.
+// Main thread only (one batch at a time). fn is called through a plain
+// function pointer, so nothing is wrapped or allocated per call.
+template <typename Fn>
+void parallelFor(int count, const Fn& fn)
+{
+    if (count <= 0) return;
+    startWorkers();
+
+    std::unique_lock<std::mutex> lock(workerMutex);
+    workerBatch.call      = [](const void* f, int i) { (*(const Fn*)f)(i); };
+    workerBatch.fn        = &fn;
+    workerBatch.count     = count;
+    workerBatch.next      = 0;
+    workerBatch.remaining = count;
+    workerWake.notify_all();
+
+    workerBatchDone.wait(lock, [] { return workerBatch.remaining == 0; });
+    workerBatch.count = workerBatch.next = 0;
+}
+
+// --------------------------------------------------
+// PLAN EXPORT (tiled, multithreaded, streamed to disk)
+// --------------------------------------------------
+// The plan is rasterized at any resolution into horizontal bands of
+// PLAN_TILE_SIZE rows. Tiles in a band render in parallel, each clipping
+// every primitive to its own rectangle; the finished band is appended to
+// the PPM and reused, so memory stays at one band regardless of size.
+const int PLAN_EXTENT_MIN_X = 50;   // plan space framed by the export
+const int PLAN_EXTENT_MAX_X = 950;
+const int PLAN_EXTENT_MIN_Y = 50;
+const int PLAN_EXTENT_MAX_Y = 750;
+const int PLAN_TILE_SIZE    = 256;
+const int PLAN_EXPORT_MAX_WIDTH = 200000;
+
+// Plan space -> export image pixels (origin at the extent's corner)
+void scalePlanPrimitives(std::vector<PlanPrimitive>& prims, std::vector<int>& verts, double scale)
+{
+    for (size_t i = 0; i < verts.size(); i += 2)
+    {
+        verts[i]     = (int)std::lround((verts[i]     - PLAN_EXTENT_MIN_X) * scale);
+        verts[i + 1] = (int)std::lround((verts[i + 1] - PLAN_EXTENT_MIN_Y) * scale);
+    }
+    for (size_t i = 0; i < prims.size(); ++i)
+    {
+        PlanPrimitive& p = prims[i];
+        if (p.type == PLAN_POLYGON_FILL) continue;
+
+        p.x1 = (int)std::lround((p.x1 - PLAN_EXTENT_MIN_X) * scale);
+        p.y1 = (int)std::lround((p.y1 - PLAN_EXTENT_MIN_Y) * scale);
+        if (p.type == PLAN_LINE || p.type == PLAN_RECT_FILL)
+        {
+            p.x2 = (int)std::lround((p.x2 - PLAN_EXTENT_MIN_X) * scale);
+            p.y2 = (int)std::lround((p.y2 - PLAN_EXTENT_MIN_Y) * scale);
+        }
+        else
+        {
+            p.x2 = (int)std::lround(p.x2 * scale);
+        }
+    }
+}
+
+// Writes the current plan (same toggles as the screen) as a binary PPM
+bool exportPlanImage(const char* path, int width)
+{
+    width = std::max(1, std::min(width, PLAN_EXPORT_MAX_WIDTH));
+    double scale = width / (double)(PLAN_EXTENT_MAX_X - PLAN_EXTENT_MIN_X);
+    int height = (int)std::lround((PLAN_EXTENT_MAX_Y - PLAN_EXTENT_MIN_Y) * scale);
+
+    buildOfficePlan2D();
+    std::vector<PlanPrimitive> prims = planPrims;
+    std::vector<int> verts = planPolyVerts;
+    scalePlanPrimitives(prims, verts, scale);
+
+    FILE* f = std::fopen(path, "wb");
+    if (!f) return false;
+    std::fprintf(f, "P6\n%d %d\n255\n", width, height);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    int tilesX = (width + PLAN_TILE_SIZE - 1) / PLAN_TILE_SIZE;
+
+    std::vector<uint32_t>      band((size_t)width * PLAN_TILE_SIZE);
+    std::vector<unsigned char> row((size_t)width * 3);
+
+    // Bands go top to bottom, matching PPM row order
+    for (int bandTop = height; bandTop > 0; bandTop -= PLAN_TILE_SIZE)
+    {
+        int bandY0 = std::max(0, bandTop - PLAN_TILE_SIZE);
+        int bandH  = bandTop - bandY0;
+
+        parallelFor(tilesX, [&](int tx)
+        {
+            PlanTile t;
+            t.x0     = tx * PLAN_TILE_SIZE;
+            t.y0     = bandY0;
+            t.w      = std::min(PLAN_TILE_SIZE, width - t.x0);
+            t.h      = bandH;
+            t.stride = width;
+            t.pixels = &band[t.x0];
+            // Workers are long-lived, so each keeps its scratch across tiles and exports
+            static thread_local RasterScratch scratch;
+            rasterPlanTile(t, scratch, prims, verts);
+        });
+
+        for (int y = bandH - 1; y >= 0; --y)
+        {
+            const uint32_t* src = &band[(size_t)y * width];
+            for (int x = 0; x < width; ++x)
+            {
+                row[x * 3 + 0] = (unsigned char)(src[x]);
+                row[x * 3 + 1] = (unsigned char)(src[x] >> 8);
+                row[x * 3 + 2] = (unsigned char)(src[x] >> 16);
+            }
+            std::fwrite(&row[0], 1, row.size(), f);
+        }
+    }
+
+    bool ok = !std::ferror(f);
+    std::fclose(f);
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("Exported plan %dx%d to %s in %.2f s\n", width, height, path, secs);
+    return ok;
+}
+
+// --------------------------------------------------
+// GL BUFFER ENTRY POINTS (loaded at runtime)
+// --------------------------------------------------
+PFNGLGENBUFFERSPROC              pglGenBuffers              = nullptr;
+PFNGLDELETEBUFFERSPROC           pglDeleteBuffers           = nullptr;
+PFNGLBINDBUFFERPROC              pglBindBuffer              = nullptr;
+PFNGLBUFFERDATAPROC              pglBufferData              = nullptr;
+PFNGLMAPBUFFERPROC               pglMapBuffer               = nullptr;
+PFNGLUNMAPBUFFERPROC             pglUnmapBuffer             = nullptr;
+
+PFNGLGENFRAMEBUFFERSPROC         pglGenFramebuffers         = nullptr;
+PFNGLDELETEFRAMEBUFFERSPROC      pglDeleteFramebuffers      = nullptr;
+PFNGLBINDFRAMEBUFFERPROC         pglBindFramebuffer         = nullptr;
+PFNGLGENRENDERBUFFERSPROC        pglGenRenderbuffers        = nullptr;
+PFNGLDELETERENDERBUFFERSPROC     pglDeleteRenderbuffers     = nullptr;
+PFNGLBINDRENDERBUFFERPROC        pglBindRenderbuffer        = nullptr;
+PFNGLRENDERBUFFERSTORAGEPROC     pglRenderbufferStorage     = nullptr;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC pglFramebufferRenderbuffer = nullptr;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC  pglCheckFramebufferStatus  = nullptr;
+PFNGLBLITFRAMEBUFFERPROC         pglBlitFramebuffer         = nullptr;
+
+bool hasBufferObjects = false;
+bool hasFramebuffers  = false;
+bool hasFramebufferBlit = false;
+
+// Entry points come from GLUT, or from EGL when the self test runs headless
+// (GLUT is never initialised there)
+void* glProcAddress(const char* name)
+{
+#if defined(OFFICE_SELFTEST) && !defined(_WIN32)
+    if (eglGetCurrentContext() != EGL_NO_CONTEXT) return (void*)eglGetProcAddress(name);
+#endif
+    return (void*)glutGetProcAddress(name);
+}
+
+void loadGLExtensions()
+{
+    pglGenBuffers    = (PFNGLGENBUFFERSPROC)   glProcAddress("glGenBuffers");
+    pglDeleteBuffers = (PFNGLDELETEBUFFERSPROC)glProcAddress("glDeleteBuffers");
+    pglBindBuffer    = (PFNGLBINDBUFFERPROC)   glProcAddress("glBindBuffer");
+    pglBufferData    = (PFNGLBUFFERDATAPROC)   glProcAddress("glBufferData");
+    pglMapBuffer     = (PFNGLMAPBUFFERPROC)    glProcAddress("glMapBuffer");
+    pglUnmapBuffer   = (PFNGLUNMAPBUFFERPROC)  glProcAddress("glUnmapBuffer");
+
+    pglGenFramebuffers         = (PFNGLGENFRAMEBUFFERSPROC)        glProcAddress("glGenFramebuffers");
+    pglDeleteFramebuffers      = (PFNGLDELETEFRAMEBUFFERSPROC)     glProcAddress("glDeleteFramebuffers");
+    pglBindFramebuffer         = (PFNGLBINDFRAMEBUFFERPROC)        glProcAddress("glBindFramebuffer");
+    pglGenRenderbuffers        = (PFNGLGENRENDERBUFFERSPROC)       glProcAddress("glGenRenderbuffers");
+    pglDeleteRenderbuffers     = (PFNGLDELETERENDERBUFFERSPROC)    glProcAddress("glDeleteRenderbuffers");
+    pglBindRenderbuffer        = (PFNGLBINDRENDERBUFFERPROC)       glProcAddress("glBindRenderbuffer");
+    pglRenderbufferStorage     = (PFNGLRENDERBUFFERSTORAGEPROC)    glProcAddress("glRenderbufferStorage");
+    pglFramebufferRenderbuffer = (PFNGLFRAMEBUFFERRENDERBUFFERPROC)glProcAddress("glFramebufferRenderbuffer");
+    pglCheckFramebufferStatus  = (PFNGLCHECKFRAMEBUFFERSTATUSPROC) glProcAddress("glCheckFramebufferStatus");
+    pglBlitFramebuffer         = (PFNGLBLITFRAMEBUFFERPROC)        glProcAddress("glBlitFramebuffer");
+
+    hasBufferObjects = pglGenBuffers && pglDeleteBuffers && pglBindBuffer &&
+                       pglBufferData && pglMapBuffer && pglUnmapBuffer;
+    hasFramebuffers  = pglGenFramebuffers && pglDeleteFramebuffers && pglBindFramebuffer &&
+                       pglGenRenderbuffers && pglDeleteRenderbuffers && pglBindRenderbuffer &&
+                       pglRenderbufferStorage && pglFramebufferRenderbuffer &&
+                       pglCheckFramebufferStatus;
+    hasFramebufferBlit = hasFramebuffers && pglBlitFramebuffer;
+}
+
+// --------------------------------------------------
+// SCENE CACHE (versioned, memory-mapped)
+// --------------------------------------------------
+// Everything derived from the layout is baked once into scene_cache.bin:
+// mesh vertices/indices, the instance table, the pick objects, both
+// picking BVHs and the startup plan as spans. The file is keyed by a hash
+// of the raw layout tables (layoutObjects, layoutParts, the PLAN_*
+// footprints), so editing any of them rebuilds it on the next start, and
+// computing the key needs no tessellation or plan build. A valid cache is
+// mapped, not parsed: the map checks the header and section bounds, the
+// mesh and spans are used in place and their contents are checked on
+// first use, and only the per-object arrays (pick objects, BVHs) are
+// copied. Startup cost doesn't grow with the mesh.
+// Bump SCENE_CACHE_VERSION whenever a cached struct, the tessellation,
+// the pick shapes or the plan drawing code changes.
+const char*    SCENE_CACHE_FILE    = "scene_cache.bin";
+const uint32_t SCENE_CACHE_VERSION = 3;
+const char     SCENE_CACHE_MAGIC[8] = { 'O', 'D', 'S', 'C', 'E', 'N', 'E', 0 };
+const int      PLAN_CACHE_WIDTH  = 1000;   // default window size
+const int      PLAN_CACHE_HEIGHT = 900;
+
+enum SceneCacheSection
+{
+    CACHE_VERTICES, CACHE_INDICES, CACHE_INSTANCES, CACHE_PICK_OBJECTS,
+    CACHE_BVH3D_NODES, CACHE_BVH3D_INDICES, CACHE_BVH2D_NODES, CACHE_BVH2D_INDICES,
+    CACHE_PLAN_SPANS, CACHE_SECTION_COUNT
+};
+
+struct SceneCacheHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t layoutHash;
+    uint64_t planHash;
+    int32_t  planWidth, planHeight;
+    uint64_t offset[CACHE_SECTION_COUNT];   // from the start of the file, 16-aligned
+    uint64_t size[CACHE_SECTION_COUNT];     // bytes
+};
+
+struct MappedFile
+{
+    const unsigned char* data;
+    size_t               size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int    fd;
+#endif
+};
+
+MappedFile           sceneCacheMap = {};
+std::vector<PlanSpan> planSpanStore;
+
+bool mapFile(const char* path, MappedFile& m)
+{
+    m = MappedFile();
+#ifdef _WIN32
+    m.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m.file, &size) || size.QuadPart == 0 ||
+        !(m.mapping = CreateFileMappingA(m.file, nullptr, PAGE_READONLY, 0, 0, nullptr)))
+    {
+        CloseHandle(m.file);
+        return false;
+    }
+    m.data = (const unsigned char*)MapViewOfFile(m.mapping, FILE_MAP_READ, 0, 0, 0);
+    m.size = (size_t)size.QuadPart;
+    if (!m.data)
+    {
+        CloseHandle(m.mapping);
+        CloseHandle(m.file);
+        return false;
+    }
+#else
+    m.fd = open(path, O_RDONLY);
+    if (m.fd < 0) return false;
+    struct stat st;
+    if (fstat(m.fd, &st) != 0 || st.st_size == 0)
+    {
+        close(m.fd);
+        return false;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m.fd, 0);
+    if (p == MAP_FAILED)
+    {
+        close(m.fd);
+        return false;
+    }
+    m.data = (const unsigned char*)p;
+    m.size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void unmapFile(MappedFile& m)
+{
+    if (!m.data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m.data);
+    CloseHandle(m.mapping);
+    CloseHandle(m.file);
+#else
+    munmap((void*)m.data, m.size);
+    close(m.fd);
+#endif
+    m = MappedFile();
+}
+
+// The raw layout tables and plan footprints the cache is built from;
+// names are hashed as strings
+uint64_t sceneLayoutHash()
+{
+    uint64_t h = hashBytes(&SCENE_CACHE_VERSION, sizeof(SCENE_CACHE_VERSION));
+    for (int i = 0; i < LAYOUT_OBJECT_COUNT; ++i)
+    {
+        const LayoutObject& o = layoutObjects[i];
+        float v[5] = { o.x, o.y, o.z, (float)o.anim, (float)o.occluder };
+        h = hashBytes(o.name, std::strlen(o.name) + 1, h);
+        h = hashBytes(v, sizeof(v), h);
+    }
+    h = hashBytes(layoutParts, sizeof(layoutParts), h);
+    for (int i = 0; i < PLAN_ONLY_PICK_COUNT; ++i)
+        h = hashBytes(PLAN_ONLY_PICK_NAMES[i], std::strlen(PLAN_ONLY_PICK_NAMES[i]) + 1, h);
+
+    const int plan[] = { PLAN_ROOM_MIN_X, PLAN_ROOM_MAX_X, PLAN_ROOM_MIN_Y, PLAN_ROOM_MAX_Y,
+                         PLAN_TABLE_X, PLAN_TABLE_Y, PLAN_TABLE_R, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT };
+    const PlanRect rects[] = { PLAN_DESK_RECT, PLAN_CHAIR_RECT, PLAN_DOOR_RECT,
+                               PLAN_WINDOW_RECTS[0], PLAN_WINDOW_RECTS[1] };
+    h = hashBytes(plan, sizeof(plan), h);
+    return hashBytes(rects, sizeof(rects), h);
+}
+
+// Pick objects, mesh, BVHs and startup plan spans from the current layout
+// (no file I/O). Builds the startup plan primitives as well.
+void buildScene()
+{
+    definePickObjects();
+    buildSceneMesh();
+    buildPickingBvh();
+
+    buildOfficePlan2D();
+    uint64_t planHash = hashPlanPrims(planPrims, planPolyVerts);
+
+    std::vector<uint32_t> pixels((size_t)PLAN_CACHE_WIDTH * PLAN_CACHE_HEIGHT);
+    PlanTile t = { &pixels[0], PLAN_CACHE_WIDTH, 0, 0, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT };
+    rasterPlanTile(t, planRasterScratch, planPrims, planPolyVerts);
+    encodePlanSpans(pixels, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT, planSpanStore);
+
+    planCacheSpans     = planSpanStore.empty() ? nullptr : &planSpanStore[0];
+    planCacheSpanCount = planSpanStore.size();
+    planCacheHash      = planHash;
+    planCacheW         = PLAN_CACHE_WIDTH;
+    planCacheH         = PLAN_CACHE_HEIGHT;
+}
+
+// Written to a temp file and renamed, so a reader never maps a partial cache
+bool writeSceneCache(const char* path, uint64_t layoutHash)
+{
+    const void* data[CACHE_SECTION_COUNT] = {
+        sceneVertices, sceneIndices, sceneInstances, pickObjectBase.data(),
+        pickBvh3D.nodes.data(), pickBvh3D.indices.data(),
+        pickBvh2D.nodes.data(), pickBvh2D.indices.data(), planCacheSpans
+    };
+
+    SceneCacheHeader header = {};
+    std::memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+    header.version      = SCENE_CACHE_VERSION;
+    header.sectionCount = CACHE_SECTION_COUNT;
+    header.layoutHash   = layoutHash;
+    header.planHash     = planCacheHash;
+    header.planWidth    = planCacheW;
+    header.planHeight   = planCacheH;
+    header.size[CACHE_VERTICES]      = sceneVertexCount * sizeof(SceneVertex);
+    header.size[CACHE_INDICES]       = sceneIndexCount * sizeof(uint32_t);
+    header.size[CACHE_INSTANCES]     = sceneInstanceCount * sizeof(SceneInstance);
+    header.size[CACHE_PICK_OBJECTS]  = pickObjectBase.size() * sizeof(PickObject);   // names fixed up on map
+    header.size[CACHE_BVH3D_NODES]   = pickBvh3D.nodes.size() * sizeof(BvhNode);
+    header.size[CACHE_BVH3D_INDICES] = pickBvh3D.indices.size() * sizeof(int);
+    header.size[CACHE_BVH2D_NODES]   = pickBvh2D.nodes.size() * sizeof(BvhNode);
+    header.size[CACHE_BVH2D_INDICES] = pickBvh2D.indices.size() * sizeof(int);
+    header.size[CACHE_PLAN_SPANS]    = planCacheSpanCount * sizeof(PlanSpan);
+
+    uint64_t offset = (sizeof(SceneCacheHeader) + 15) & ~(uint64_t)15;
+    for (int i = 0; i < CACHE_SECTION_COUNT; ++i)
+    {
+        header.offset[i] = offset;
+        offset = (offset + header.size[i] + 15) & ~(uint64_t)15;
+    }
+
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+
+    static const unsigned char zeros[16] = {};
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t written = sizeof(header);
+    for (int i = 0; i < CACHE_SECTION_COUNT && ok; ++i)
+    {
+        ok = std::fwrite(zeros, 1, (size_t)(header.offset[i] - written), f) == header.offset[i] - written &&
+             (header.size[i] == 0 || std::fwrite(data[i], 1, (size_t)header.size[i], f) == header.size[i]);
+        written = header.offset[i] + header.size[i];
+    }
+    ok = (std::fclose(f) == 0) && ok;
+
+    std::error_code ec;
+    if (ok) std::filesystem::rename(tmp, path, ec);
+    if (!ok || ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+// Children come after their parent and a tree over n objects has at most
+// 2n - 1 nodes, which also bounds the pick traversal stacks
+bool bvhRangesValid(const BvhNode* nodes, size_t nodeCount, const int* indices, size_t indexCount,
+                    size_t objectCount)
+{
+    if (nodeCount > 2 * objectCount) return false;
+    for (size_t i = 0; i < nodeCount; ++i)
+    {
+        const BvhNode& n = nodes[i];
+        bool ok = (n.count > 0) ? n.first >= 0 && (size_t)n.first + n.count <= indexCount
+                                : n.count == 0 && n.first > (int)i && (size_t)n.first + 1 < nodeCount;
+        if (!ok) return false;
+    }
+    for (size_t i = 0; i < indexCount; ++i)
+        if (indices[i] < 0 || (size_t)indices[i] >= objectCount) return false;
+    return true;
+}
+
+// Maps path and points the scene at it when it is a cache for layoutHash;
+// otherwise leaves the current scene untouched and returns false. Only the
+// header, the section bounds and the copied per-object arrays are checked
+// here; the mesh and plan spans are checked as they are used
+// (sceneInstanceValid, decodePlanSpans).
+bool mapSceneCache(const char* path, uint64_t layoutHash)
+{
+    MappedFile m;
+    if (!mapFile(path, m)) return false;
+
+    const SceneCacheHeader* h = (const SceneCacheHeader*)m.data;
+    const size_t elemSize[CACHE_SECTION_COUNT] = {
+        sizeof(SceneVertex), sizeof(uint32_t), sizeof(SceneInstance), sizeof(PickObject),
+        sizeof(BvhNode), sizeof(int), sizeof(BvhNode), sizeof(int), sizeof(PlanSpan)
+    };
+
+    bool ok = m.size >= sizeof(SceneCacheHeader) &&
+              std::memcmp(h->magic, SCENE_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+              h->version == SCENE_CACHE_VERSION && h->sectionCount == CACHE_SECTION_COUNT &&
+              h->layoutHash == layoutHash;
+    for (int i = 0; i < CACHE_SECTION_COUNT && ok; ++i)
+        ok = h->offset[i] % 16 == 0 && h->offset[i] <= m.size &&
+             h->size[i] <= m.size - h->offset[i] && h->size[i] % elemSize[i] == 0;
+    ok = ok && h->planWidth > 0 && h->planHeight > 0;
+
+    const unsigned char* base = m.data;
+    const PickObject* picks = ok ? (const PickObject*)(base + h->offset[CACHE_PICK_OBJECTS]) : nullptr;
+    size_t pickCount = ok ? h->size[CACHE_PICK_OBJECTS] / sizeof(PickObject) : 0;
+    for (size_t i = 0; i < pickCount && ok; ++i)
+        ok = picks[i].source >= 0 && picks[i].source < LAYOUT_OBJECT_COUNT + PLAN_ONLY_PICK_COUNT;
+    ok = ok && bvhRangesValid((const BvhNode*)(base + h->offset[CACHE_BVH3D_NODES]),
+                              h->size[CACHE_BVH3D_NODES] / sizeof(BvhNode),
+                              (const int*)(base + h->offset[CACHE_BVH3D_INDICES]),
+                              h->size[CACHE_BVH3D_INDICES] / sizeof(int), pickCount) &&
+               bvhRangesValid((const BvhNode*)(base + h->offset[CACHE_BVH2D_NODES]),
+                              h->size[CACHE_BVH2D_NODES] / sizeof(BvhNode),
+                              (const int*)(base + h->offset[CACHE_BVH2D_INDICES]),
+                              h->size[CACHE_BVH2D_INDICES] / sizeof(int), pickCount);
+    if (!ok)
+    {
+        unmapFile(m);
+        return false;
+    }
+
+    sceneVertices      = (const SceneVertex*)(base + h->offset[CACHE_VERTICES]);
+    sceneIndices       = (const uint32_t*)(base + h->offset[CACHE_INDICES]);
+    sceneInstances     = (const SceneInstance*)(base + h->offset[CACHE_INSTANCES]);
+    sceneVertexCount   = h->size[CACHE_VERTICES]  / sizeof(SceneVertex);
+    sceneIndexCount    = h->size[CACHE_INDICES]   / sizeof(uint32_t);
+    sceneInstanceCount = h->size[CACHE_INSTANCES] / sizeof(SceneInstance);
+    sceneInstanceChecked.assign(sceneInstanceCount, 0);
+
+    // Copied so furniture moves can edit them; names point into this binary
+    pickObjectBase.assign(picks, picks + pickCount);
+    for (size_t i = 0; i < pickObjectBase.size(); ++i)
+        pickObjectBase[i].name = pickSourceName(pickObjectBase[i].source);
+    pickObjects = pickObjectBase;
+    pickDoorIndex = -1;
+    for (size_t i = 0; i < pickObjects.size(); ++i)
+        if (pickObjects[i].source == OBJ_DOOR) pickDoorIndex = (int)i;
+    if (pickDoorIndex >= 0) updateDoorPickShape(pickObjects[pickDoorIndex], doorAngleDeg);
+
+    const BvhNode* n3 = (const BvhNode*)(base + h->offset[CACHE_BVH3D_NODES]);
+    const int*     i3 = (const int*)(base + h->offset[CACHE_BVH3D_INDICES]);
+    const BvhNode* n2 = (const BvhNode*)(base + h->offset[CACHE_BVH2D_NODES]);
+    const int*     i2 = (const int*)(base + h->offset[CACHE_BVH2D_INDICES]);
+    pickBvh3D.nodes.assign(n3, n3 + h->size[CACHE_BVH3D_NODES] / sizeof(BvhNode));
+    pickBvh3D.indices.assign(i3, i3 + h->size[CACHE_BVH3D_INDICES] / sizeof(int));
+    pickBvh2D.nodes.assign(n2, n2 + h->size[CACHE_BVH2D_NODES] / sizeof(BvhNode));
+    pickBvh2D.indices.assign(i2, i2 + h->size[CACHE_BVH2D_INDICES] / sizeof(int));
+
+    planCacheSpans     = (const PlanSpan*)(base + h->offset[CACHE_PLAN_SPANS]);
+    planCacheSpanCount = h->size[CACHE_PLAN_SPANS] / sizeof(PlanSpan);
+    planCacheHash      = h->planHash;
+    planCacheW         = h->planWidth;
+    planCacheH         = h->planHeight;
+
+    // Views now point into m; the previous mapping (if any) is unused
+    unmapFile(sceneCacheMap);
+    sceneCacheMap = m;
+    return true;
+}
+
+// Startup: map the cache for the current layout, or build and write it
+void loadOrBuildScene()
+{
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+
+    uint64_t layoutHash = sceneLayoutHash();
+    bool mapped = mapSceneCache(SCENE_CACHE_FILE, layoutHash);
+    if (!mapped)
+    {
+        buildScene();
+        if (!writeSceneCache(SCENE_CACHE_FILE, layoutHash))
+            std::fprintf(stderr, "Could not write %s\n", SCENE_CACHE_FILE);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::printf("Scene %s %s: %zu vertices, %zu triangles, %zu objects (%.2f ms)\n",
+                mapped ? "mapped from" : "built, cached to", SCENE_CACHE_FILE,
+                sceneVertexCount, sceneIndexCount / 3, sceneInstanceCount, ms);
+}
+
+// --------------------------------------------------
+// OCCLUSION CULLING (CPU depth buffer + hierarchical min pyramid)
+// --------------------------------------------------
+// Occluder instances (room shell, cabinet, whiteboard, door) are
+// rasterized into a small buffer of 1/w, where larger means nearer and 0
+// means empty. Each pyramid level keeps the farthest (smallest) value of
+// its 2x2 block below. An instance's box is projected to a screen rect
+// and the rect's nearest 1/w is compared with the pyramid level where the
+// rect covers at most 2x2 texels. If the box is nearer nowhere, every
+// point of it lies behind an occluder and it is not submitted. Boxes off
+// screen are dropped too. Everything is CPU-side, with no GL queries,
+// so it also runs headless.
+const int   OCC_W          = 256;     // multiple of 4 (SSE2 rows)
+const int   OCC_H          = 192;
+const float OCC_NEAR_W     = 0.1f;    // near plane, as in renderScene
+const float OCC_DEPTH_BIAS = 0.999f;  // keep boxes that touch an occluder
+
+bool occlusionCulling = true;
+
+std::vector<float>              occDepth;          // level 0, OCC_W * OCC_H
+std::vector<std::vector<float> > occPyramid;       // levels 1.., min of 2x2
+std::vector<int>                occLevelW, occLevelH;
+std::vector<unsigned char>      sceneVisible;      // per instance, last cull
+
+struct OccVertex
+{
+    float x, y, invW;   // occlusion-buffer pixels, 1/w
+};
+
+void transformToClip(const float m[16], float x, float y, float z, float clip[4])
+{
+    for (int r = 0; r < 4; ++r)
+        clip[r] = m[r] * x + m[4 + r] * y + m[8 + r] * z + m[12 + r];
+}
+
+OccVertex clipToOccVertex(const float clip[4])
+{
+    float invW = 1.0f / clip[3];
+    OccVertex v = { (clip[0] * invW * 0.5f + 0.5f) * OCC_W,
+                    (clip[1] * invW * 0.5f + 0.5f) * OCC_H, invW };
+    return v;
+}
+
+// Pixel centres inside the triangle (either winding) keep the nearer 1/w
+void rasterOccluderTriangle(const OccVertex& a, const OccVertex& b, const OccVertex& c)
+{
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::fabs(area) < 1e-6f) return;
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+
+    int x0 = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+    int x1 = std::min(OCC_W - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+    int y0 = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+    int y1 = std::min(OCC_H - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+    if (x0 > x1 || y0 > y1) return;
+
+    // Edge i is >= 0 inside; E(x, y) = ex * x + ey * y + e0
+    const OccVertex* v[3] = { &a, &b, &c };
+    float ex[3], ey[3], e0[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const OccVertex& p = *v[(i + 1) % 3];
+        const OccVertex& q = *v[(i + 2) % 3];
+        ex[i] = sign * (p.y - q.y);
+        ey[i] = sign * (q.x - p.x);
+        e0[i] = sign * (p.x * q.y - p.y * q.x);
+    }
+
+    // 1/w is affine in screen space: z = zx * x + zy * y + z0
+    float inv = 1.0f / area;
+    float zx = ((b.invW - a.invW) * (c.y - a.y) - (c.invW - a.invW) * (b.y - a.y)) * inv;
+    float zy = ((c.invW - a.invW) * (b.x - a.x) - (b.invW - a.invW) * (c.x - a.x)) * inv;
+    float z0 = a.invW - zx * a.x - zy * a.y;
+
+    x0 &= ~3;
+    for (int y = y0; y <= y1; ++y)
+    {
+        float py = y + 0.5f;
+        float* row = &occDepth[(size_t)y * OCC_W];
+#if RASTER_USE_SSE2
+        const __m128 lane = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 exv[3], rowv[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            exv[i]  = _mm_set1_ps(ex[i]);
+            rowv[i] = _mm_set1_ps(ey[i] * py + e0[i]);
+        }
+        __m128 zxv = _mm_set1_ps(zx), zrow = _mm_set1_ps(zy * py + z0);
+
+        for (int x = x0; x <= x1; x += 4)
+        {
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane);
+            __m128 inside = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(exv[0], px), rowv[0]), zero),
+                           _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(exv[1], px), rowv[1]), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(exv[2], px), rowv[2]), zero));
+            __m128 z   = _mm_add_ps(_mm_mul_ps(zxv, px), zrow);
+            __m128 old = _mm_loadu_ps(row + x);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(old, z)),
+                                             _mm_andnot_ps(inside, old)));
+        }
+#else
+        for (int x = x0; x <= x1; ++x)
+        {
+            float px = x + 0.5f;
+            if (ex[0] * px + ey[0] * py + e0[0] >= 0.0f &&
+                ex[1] * px + ey[1] * py + e0[1] >= 0.0f &&
+                ex[2] * px + ey[2] * py + e0[2] >= 0.0f)
+                row[x] = std::max(row[x], zx * px + zy * py + z0);
+        }
+#endif
+    }
+}
+
+// Clips against the near plane (w >= OCC_NEAR_W), then fans the polygon
+void rasterOccluderClip(const float clip[3][4])
+{
+    float poly[4][4];
+    int   n = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const float* p = clip[i];
+        const float* q = clip[(i + 1) % 3];
+        bool pIn = p[3] >= OCC_NEAR_W, qIn = q[3] >= OCC_NEAR_W;
+        if (pIn) std::memcpy(poly[n++], p, sizeof(poly[0]));
+        if (pIn != qIn)
+        {
+            float t = (OCC_NEAR_W - p[3]) / (q[3] - p[3]);
+            for (int k = 0; k < 4; ++k) poly[n][k] = p[k] + (q[k] - p[k]) * t;
+            ++n;
+        }
+    }
+    if (n < 3) return;
+
+    OccVertex v0 = clipToOccVertex(poly[0]);
+    for (int i = 1; i + 1 < n; ++i)
+        rasterOccluderTriangle(v0, clipToOccVertex(poly[i]), clipToOccVertex(poly[i + 1]));
+}
+
+// Object space -> world, as drawRoomAndObjects3D places the instance
+void instanceToWorld(const SceneInstance& inst, float fanAngle, float x, float y, float z, float out[3])
+{
+    float a = 0.0f;
+    if (inst.anim == ANIM_DOOR) a = doorAngleDeg;
+    if (inst.anim == ANIM_FAN)  a = fanAngle;
+    float c = std::cos(a * 3.1415926f / 180.0f), s = std::sin(a * 3.1415926f / 180.0f);
+    out[0] =  c * x + s * z + inst.x;
+    out[1] =  y + inst.y;
+    out[2] = -s * x + c * z + inst.z;
+}
+
+void buildOcclusionPyramid()
+{
+    if (occPyramid.empty())
+    {
+        int w = OCC_W, h = OCC_H;
+        occLevelW.assign(1, w);
+        occLevelH.assign(1, h);
+        while (w > 1 || h > 1)
+        {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            occLevelW.push_back(w);
+            occLevelH.push_back(h);
+            occPyramid.push_back(std::vector<float>((size_t)w * h));
+        }
+    }
+
+    for (size_t l = 0; l < occPyramid.size(); ++l)
+    {
+        const float* src = l == 0 ? &occDepth[0] : &occPyramid[l - 1][0];
+        int sw = occLevelW[l], sh = occLevelH[l];
+        int dw = occLevelW[l + 1], dh = occLevelH[l + 1];
+        float* dst = &occPyramid[l][0];
+        for (int y = 0; y < dh; ++y)
+            for (int x = 0; x < dw; ++x)
+            {
+                int sx = 2 * x, sy = 2 * y;
+                int sx1 = std::min(sx + 1, sw - 1), sy1 = std::min(sy + 1, sh - 1);
+                dst[(size_t)y * dw + x] = std::min(std::min(src[(size_t)sy * sw + sx],  src[(size_t)sy * sw + sx1]),
+                                                   std::min(src[(size_t)sy1 * sw + sx], src[(size_t)sy1 * sw + sx1]));
+            }
+    }
+}
+
+// True when the instance's box may be visible from viewProj
+bool testInstanceVisible(const SceneInstance& inst, float fanAngle, const float viewProj[16])
+{
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 0.0f;
+    int behind = 0;
+    for (int k = 0; k < 8; ++k)
+    {
+        float world[4], clip[4];
+        instanceToWorld(inst, fanAngle, (k & 1) ? inst.boundsMax[0] : inst.boundsMin[0],
+                                        (k & 2) ? inst.boundsMax[1] : inst.boundsMin[1],
+                                        (k & 4) ? inst.boundsMax[2] : inst.boundsMin[2], world);
+        transformToClip(viewProj, world[0], world[1], world[2], clip);
+        if (clip[3] < OCC_NEAR_W)
+        {
+            ++behind;
+            continue;
+        }
+        OccVertex v = clipToOccVertex(clip);
+        minX = std::min(minX, v.x); maxX = std::max(maxX, v.x);
+        minY = std::min(minY, v.y); maxY = std::max(maxY, v.y);
+        nearest = std::max(nearest, v.invW);
+    }
+    if (behind == 8) return false;   // entirely behind the camera
+    if (behind > 0)  return true;    // straddles the near plane
+
+    if (maxX < 0.0f || maxY < 0.0f || minX >= OCC_W || minY >= OCC_H) return false;   // off screen
+
+    int x0 = std::max(0, (int)minX), x1 = std::min(OCC_W - 1, (int)maxX);
+    int y0 = std::max(0, (int)minY), y1 = std::min(OCC_H - 1, (int)maxY);
+
+    // Coarsest level first where the rect spans at most 2x2 texels
+    int level = 0;
+    while (level < (int)occLevelW.size() - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        ++level;
+
+    const float* depth = level == 0 ? &occDepth[0] : &occPyramid[level - 1][0];
+    int lw = occLevelW[level];
+    float farthest = 1e30f;
+    for (int y = y0 >> level; y <= (y1 >> level); ++y)
+        for (int x = x0 >> level; x <= (x1 >> level); ++x)
+            farthest = std::min(farthest, depth[(size_t)y * lw + x]);
+
+    return nearest >= farthest * OCC_DEPTH_BIAS;
+}
+
+// Fills sceneVisible for the fan drawn at fanAngle; returns the number of
+// culled instances
+int cullSceneInstances(const float viewProj[16], float fanAngle)
+{
+    occDepth.assign((size_t)OCC_W * OCC_H, 0.0f);
+    sceneVisible.assign(sceneInstanceCount, 1);
+
+    // An orthographic view (elevation) has 1/w = 1 everywhere, so occluders
+    // can't order anything there; it only gets the off-screen test
+    bool perspective = viewProj[3] != 0.0f || viewProj[7] != 0.0f || viewProj[11] != 0.0f;
+
+    for (size_t i = 0; i < sceneInstanceCount && perspective; ++i)
+    {
+        const SceneInstance& inst = sceneInstances[i];
+        if (!inst.occluder || !sceneInstanceValid(i)) continue;
+
+        const uint32_t* idx = sceneIndices + inst.firstIndex;
+        for (uint32_t t = 0; t + 2 < inst.indexCount; t += 3)
+        {
+            float clip[3][4];
+            for (int k = 0; k < 3; ++k)
+            {
+                const SceneVertex& v = sceneVertices[idx[t + k]];
+                float world[3];
+                instanceToWorld(inst, fanAngle, v.px, v.py, v.pz, world);
+                transformToClip(viewProj, world[0], world[1], world[2], clip[k]);
+            }
+            rasterOccluderClip(clip);
+        }
+    }
+    buildOcclusionPyramid();
+
+    int culled = 0;
+    for (size_t i = 0; i < sceneInstanceCount; ++i)
+        if (!testInstanceVisible(sceneInstances[i], fanAngle, viewProj))
+        {
+            sceneVisible[i] = 0;
+            ++culled;
+        }
+    return culled;
+}
+
+// --------------------------------------------------
+// 3D ROOM, FURNITURE, DOOR, FAN, LIGHTS
+// --------------------------------------------------
+GLuint sceneVbo = 0, sceneIbo = 0;   // 0 = draw from client memory
+
+// Straight from the cache mapping (or the built store) into GL buffers
+void uploadSceneBuffers()
+{
+    if (!hasBufferObjects || !sceneVertexCount) return;
+
+    if (!sceneVbo) pglGenBuffers(1, &sceneVbo);
+    if (!sceneIbo) pglGenBuffers(1, &sceneIbo);
+    pglBindBuffer(GL_ARRAY_BUFFER, sceneVbo);
+    pglBufferData(GL_ARRAY_BUFFER, sceneVertexCount * sizeof(SceneVertex), sceneVertices, GL_STATIC_DRAW);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sceneIbo);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, sceneIndexCount * sizeof(uint32_t), sceneIndices, GL_STATIC_DRAW);
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// base: a SceneVertex array, or nullptr for the bound GL_ARRAY_BUFFER
+void setSceneVertexPointers(const char* base)
+{
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(SceneVertex), base + offsetof(SceneVertex, px));
+    glNormalPointer(GL_FLOAT, sizeof(SceneVertex), base + offsetof(SceneVertex, nx));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(SceneVertex), base + offsetof(SceneVertex, color));
+}
+
+void clearSceneVertexPointers()
+{
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+}
+
+// One glDrawElements per visible instance; door and fan rotate about their origin
+void drawRoomAndObjects3D(float fanAngle)
+{
+    const char*     vertexBase = (const char*)sceneVertices;
+    const uint32_t* indexBase  = sceneIndices;
+    if (sceneVbo)
+    {
+        pglBindBuffer(GL_ARRAY_BUFFER, sceneVbo);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sceneIbo);
+        vertexBase = nullptr;
+        indexBase  = nullptr;
+    }
+
+    setSceneVertexPointers(vertexBase);
+
+    if (occlusionCulling)
+    {
+        float proj[16], view[16], viewProj[16];
+        glGetFloatv(GL_PROJECTION_MATRIX, proj);
+        glGetFloatv(GL_MODELVIEW_MATRIX, view);
+        multiplyMatrix4(proj, view, viewProj);
+        frameStats.culledObjects += cullSceneInstances(viewProj, fanAngle);
+    }
+
+    for (size_t i = 0; i < sceneInstanceCount; ++i)
+    {
+        const SceneInstance& inst = sceneInstances[i];
+        if ((occlusionCulling && !sceneVisible[i]) || !sceneInstanceValid(i)) continue;
+
+        glPushMatrix();
+        glTranslatef(inst.x, inst.y, inst.z);
+        if (inst.anim == ANIM_DOOR) glRotatef(doorAngleDeg, 0.0f, 1.0f, 0.0f);
+        if (inst.anim == ANIM_FAN)  glRotatef(fanAngle,     0.0f, 1.0f, 0.0f);
+
+        ++frameStats.drawCalls;
+        glDrawElements(GL_TRIANGLES, (GLsizei)inst.indexCount, GL_UNSIGNED_INT, indexBase + inst.firstIndex);
+        glPopMatrix();
+    }
+
+    clearSceneVertexPointers();
+    if (sceneVbo)
+    {
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+// --------------------------------------------------
+// FURNITURE MOVES (dragged in the plan, shown in every view)
+// --------------------------------------------------
+// A plan item carries the layout objects, pick objects and crowd
+// destinations of the same names. Moving it only shifts instance origins
+// and pick shapes: the scene mesh and its GPU buffers are untouched.
+const float PLAN_PX_PER_M_X = (PLAN_ROOM_MAX_X - PLAN_ROOM_MIN_X) / (2.0f * ROOM_HALF_WIDTH);
+const float PLAN_PX_PER_M_Z = (PLAN_ROOM_MAX_Y - PLAN_ROOM_MIN_Y) / (2.0f * ROOM_HALF_DEPTH);
+
+struct FurnitureGroup
+{
+    PlanFurniture item;
+    const char*   names[4];   // first one has the plan shape
+};
+
+const FurnitureGroup furnitureGroups[PLAN_FURNITURE_COUNT] = {
+    { PLAN_TABLE, { "Meeting table", nullptr,   nullptr,    nullptr      } },
+    { PLAN_DESK,  { "Desk",          "Monitor", "Keyboard", "Table lamp" } },
+    { PLAN_CHAIR, { "Chair",         "Person",  nullptr,    nullptr      } },
+};
+
+uint32_t sceneEditVersion = 0;   // bumped by every applyFurnitureMoves()
+
+// World offset of the named object (0 when it isn't carried by a plan item)
+void furnitureOffset(const char* name, float& dx, float& dz)
+{
+    dx = dz = 0.0f;
+    for (int g = 0; g < PLAN_FURNITURE_COUNT; ++g)
+        for (int n = 0; n < 4 && furnitureGroups[g].names[n]; ++n)
+            if (std::strcmp(furnitureGroups[g].names[n], name) == 0)
+            {
+                dx =  planMoveX[furnitureGroups[g].item] / PLAN_PX_PER_M_X;
+                dz = -planMoveY[furnitureGroups[g].item] / PLAN_PX_PER_M_Z;
+                return;
+            }
+}
+
+// Instances, pick shapes and BVHs for the current planMove offsets. A
+// mapped scene cache is read-only, so the (small) instance table is
+// copied out on the first move. Call rebuildNavigation() afterwards if
+// the crowd is using the grid.
+void applyFurnitureMoves()
+{
+    if (sceneInstanceCount && sceneInstances != sceneInstanceStore.data())
+    {
+        sceneInstanceStore.assign(sceneInstances, sceneInstances + sceneInstanceCount);
+        sceneInstances = &sceneInstanceStore[0];
+    }
+    for (size_t i = 0; i < sceneInstanceStore.size() && i < (size_t)LAYOUT_OBJECT_COUNT; ++i)
+    {
+        float dx, dz;
+        furnitureOffset(layoutObjects[i].name, dx, dz);
+        sceneInstanceStore[i].x = layoutObjects[i].x + dx;
+        sceneInstanceStore[i].z = layoutObjects[i].z + dz;
+    }
+
+    pickObjects = pickObjectBase;
+    for (size_t i = 0; i < pickObjects.size(); ++i)
+    {
+        PickObject& o = pickObjects[i];
+        float dx, dz;
+        furnitureOffset(o.name, dx, dz);
+        o.cx += dx;
+        o.cz += dz;
+        o.px += dx * PLAN_PX_PER_M_X;
+        o.py -= dz * PLAN_PX_PER_M_Z;
+    }
+    buildPickingBvh();
+    ++sceneEditVersion;
+}
+
+// --------------------------------------------------
+// OCCUPANCY SIMULATION (nav grid, flow fields, batched figures)
+// --------------------------------------------------
+// Agents walk between a few destinations on a grid over the room floor,
+// dwell there (seated or standing), and leave / re-enter through the door.
+// Each destination has one flow field (Dijkstra from its goal cells) built
+// when the grid changes and shared by every agent, so steering is a cell
+// lookup whatever the agent count. The tick updates agents in parallel
+// chunks and writes their figures straight into one vertex array: each
+// figure is a copy of a pre-tessellated pose (seated, or a walk-cycle
+// keyframe of rigid parts) rotated to the agent's heading, so the whole
+// crowd is a single glDrawElements.
+const float NAV_CELL          = 0.25f;
+const int   NAV_W             = 48;      // 2 * ROOM_HALF_WIDTH / NAV_CELL
+const int   NAV_H             = 64;      // 2 * ROOM_HALF_DEPTH / NAV_CELL
+const float AGENT_RADIUS      = 0.2f;
+const float AGENT_SPEED       = 1.3f;    // m/s
+const float CROWD_TICK_SEC    = 0.016f;  // one stepAnimation tick
+const int   CROWD_WALK_POSES  = 16;      // keyframes per stride cycle
+const int   CROWD_POSE_COUNT  = 1 + CROWD_WALK_POSES;   // 0 = seated
+const int   CROWD_CHUNK       = 256;     // agents per job
+const int   CROWD_MAX_AGENTS  = 16384;
+
+enum AgentState { AGENT_WALKING, AGENT_DWELLING, AGENT_AWAY };
+
+struct Agent
+{
+    float    x, z;
+    float    yawRad;     // figure faces -Z at 0
+    float    stride;     // walk cycle phase, 0..1
+    float    timer;      // seconds left dwelling / away
+    int      dest;
+    int      state;      // AgentState
+    uint32_t rng;
+};
+
+// Goal cells are the free cells within radius of (x, z)
+struct CrowdDestination
+{
+    const char* name;
+    float       x, z, radius;
+    bool        sit;     // dwell seated, facing (x, z)
+    bool        exit;    // leave through the door
+};
+
+const CrowdDestination crowdDestinations[] = {
+    { "Meeting table",  0.0f,                    0.0f,                    2.2f, true,  false },
+    { "Desk",          -3.0f,                    0.1f,                    0.9f, true,  false },
+    { "Whiteboard",     0.0f,                   -ROOM_HALF_DEPTH + 1.5f,  2.0f, false, false },
+    { "Cabinet",        ROOM_HALF_WIDTH - 1.0f, -ROOM_HALF_DEPTH + 3.2f,  0.8f, false, false },
+    { "Plant corner",  -ROOM_HALF_WIDTH + 1.0f,  ROOM_HALF_DEPTH - 2.2f,  1.0f, false, false },
+    { "Door",           0.0f,                    ROOM_HALF_DEPTH - 0.2f,  1.2f, false, true  },
+};
+const int CROWD_DEST_COUNT = (int)(sizeof(crowdDestinations) / sizeof(crowdDestinations[0]));
+
+struct FlowField
+{
+    std::vector<float> cost;         // path length to the nearest goal cell
+    std::vector<float> dirX, dirZ;   // unit step toward it (0 at goals)
+};
+
+bool                       crowdEnabled    = false;
+int                        crowdAgentCount = 2000;
+bool                       navGridValid    = false;
+std::vector<unsigned char> navBlocked;          // NAV_W * NAV_H
+std::vector<int>           navFreeCells;        // unblocked cells, for spawning
+std::vector<int>           navNearestFree;      // per cell: closest unblocked cell
+std::vector<FlowField>     crowdFields;         // one per destination
+float crowdGoalX[CROWD_DEST_COUNT], crowdGoalZ[CROWD_DEST_COUNT];   // after furniture moves
+std::vector<Agent>         crowdAgents;
+
+std::vector<SceneVertex>   crowdPoseVertices;   // CROWD_POSE_COUNT poses
+std::vector<uint32_t>      crowdPoseIndices;    // shared by every pose
+int                        crowdPoseVertexCount = 0;
+
+std::vector<SceneVertex>   crowdVertices;       // agents * pose vertices
+std::vector<uint32_t>      crowdIndices;
+bool                       crowdVerticesDirty = false;
+uint32_t                   crowdTick = 0;       // figures moved (view redraws)
+GLuint crowdVbo = 0, crowdIbo = 0;
+int    crowdIboAgents = 0;
+
+const float INF_COST = 1e30f;
+
+int navCellX(float x) { return std::min(NAV_W - 1, std::max(0, (int)((x + ROOM_HALF_WIDTH) / NAV_CELL))); }
+int navCellZ(float z) { return std::min(NAV_H - 1, std::max(0, (int)((z + ROOM_HALF_DEPTH) / NAV_CELL))); }
+float navCenterX(int i) { return -ROOM_HALF_WIDTH + (i + 0.5f) * NAV_CELL; }
+float navCenterZ(int j) { return -ROOM_HALF_DEPTH + (j + 0.5f) * NAV_CELL; }
+
+uint32_t nextRandom(uint32_t& s)
+{
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+float randomUnit(uint32_t& s)
+{
+    return (nextRandom(s) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Floor-standing pick objects (everything reaching below 1 m except the
+// door) block the cells under their footprint, grown by the agent radius
+void buildNavGrid()
+{
+    navBlocked.assign((size_t)NAV_W * NAV_H, 0);
+    for (size_t o = 0; o < pickObjects.size(); ++o)
+    {
+        const PickObject& p = pickObjects[o];
+        if (!p.in3D || (int)o == pickDoorIndex) continue;
+
+        AABB b = pickObjectBounds3D(p);
+        if (b.minY >= 1.0f) continue;
+
+        for (int j = 0; j < NAV_H; ++j)
+            for (int i = 0; i < NAV_W; ++i)
+            {
+                float x = navCenterX(i), z = navCenterZ(j);
+                if (x > b.minX - AGENT_RADIUS && x < b.maxX + AGENT_RADIUS &&
+                    z > b.minZ - AGENT_RADIUS && z < b.maxZ + AGENT_RADIUS)
+                    navBlocked[(size_t)j * NAV_W + i] = 1;
+            }
+    }
+
+    // Breadth-first out of every free cell, so a blocked cell knows its
+    // closest way out (furniture dropped on an agent)
+    navFreeCells.clear();
+    navNearestFree.assign((size_t)NAV_W * NAV_H, -1);
+    for (int c = 0; c < NAV_W * NAV_H; ++c)
+        if (!navBlocked[c])
+        {
+            navFreeCells.push_back(c);
+            navNearestFree[c] = c;
+        }
+    std::vector<int> frontier = navFreeCells;
+    for (size_t f = 0; f < frontier.size(); ++f)
+    {
+        int c = frontier[f], ci = c % NAV_W, cj = c / NAV_W;
+        const int ns[4][2] = { { ci - 1, cj }, { ci + 1, cj }, { ci, cj - 1 }, { ci, cj + 1 } };
+        for (int k = 0; k < 4; ++k)
+        {
+            if (ns[k][0] < 0 || ns[k][1] < 0 || ns[k][0] >= NAV_W || ns[k][1] >= NAV_H) continue;
+            int n = ns[k][1] * NAV_W + ns[k][0];
+            if (navNearestFree[n] >= 0) continue;
+            navNearestFree[n] = navNearestFree[c];
+            frontier.push_back(n);
+        }
+    }
+}
+
+// Dijkstra over 8-neighbours; diagonals only between two free side cells
+void buildFlowField(const CrowdDestination& d, float goalX, float goalZ, FlowField& f)
+{
+    const int cells = NAV_W * NAV_H;
+    f.cost.assign(cells, INF_COST);
+    f.dirX.assign(cells, 0.0f);
+    f.dirZ.assign(cells, 0.0f);
+
+    typedef std::pair<float, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > open;
+    for (int j = 0; j < NAV_H; ++j)
+        for (int i = 0; i < NAV_W; ++i)
+        {
+            int c = j * NAV_W + i;
+            float dx = navCenterX(i) - goalX, dz = navCenterZ(j) - goalZ;
+            if (!navBlocked[c] && dx * dx + dz * dz <= d.radius * d.radius)
+            {
+                f.cost[c] = 0.0f;
+                open.push(Entry(0.0f, c));
+            }
+        }
+
+    while (!open.empty())
+    {
+        Entry e = open.top();
+        open.pop();
+        if (e.first > f.cost[e.second]) continue;
+
+        int ci = e.second % NAV_W, cj = e.second / NAV_W;
+        for (int dj = -1; dj <= 1; ++dj)
+            for (int di = -1; di <= 1; ++di)
+            {
+                int ni = ci + di, nj = cj + dj;
+                if ((di == 0 && dj == 0) || ni < 0 || nj < 0 || ni >= NAV_W || nj >= NAV_H) continue;
+                int n = nj * NAV_W + ni;
+                if (navBlocked[n]) continue;
+                if (di && dj && (navBlocked[cj * NAV_W + ni] || navBlocked[nj * NAV_W + ci])) continue;
+
+                float c = e.first + ((di && dj) ? 1.41421356f : 1.0f);
+                if (c < f.cost[n])
+                {
+                    f.cost[n] = c;
+                    open.push(Entry(c, n));
+                }
+            }
+    }
+
+    // Each cell steps toward its cheapest neighbour
+    for (int j = 0; j < NAV_H; ++j)
+        for (int i = 0; i < NAV_W; ++i)
+        {
+            int c = j * NAV_W + i;
+            if (f.cost[c] == 0.0f || f.cost[c] >= INF_COST) continue;
+
+            float best = f.cost[c];
+            int   bi = 0, bj = 0;
+            for (int dj = -1; dj <= 1; ++dj)
+                for (int di = -1; di <= 1; ++di)
+                {
+                    int ni = i + di, nj = j + dj;
+                    if (ni < 0 || nj < 0 || ni >= NAV_W || nj >= NAV_H) continue;
+                    if (di && dj && (navBlocked[j * NAV_W + ni] || navBlocked[nj * NAV_W + i])) continue;
+                    float nc = f.cost[nj * NAV_W + ni];
+                    if (nc < best) { best = nc; bi = di; bj = dj; }
+                }
+            float len = std::sqrt((float)(bi * bi + bj * bj));
+            if (len > 0.0f)
+            {
+                f.dirX[c] = bi / len;
+                f.dirZ[c] = bj / len;
+            }
+        }
+}
+
+// Grid + every destination's field; call again after furniture moves
+void rebuildNavigation()
+{
+    buildNavGrid();
+    crowdFields.resize(CROWD_DEST_COUNT);
+    for (int d = 0; d < CROWD_DEST_COUNT; ++d)
+    {
+        float dx, dz;
+        furnitureOffset(crowdDestinations[d].name, dx, dz);
+        crowdGoalX[d] = crowdDestinations[d].x + dx;
+        crowdGoalZ[d] = crowdDestinations[d].z + dz;
+        buildFlowField(crowdDestinations[d], crowdGoalX[d], crowdGoalZ[d], crowdFields[d]);
+    }
+    navGridValid = true;
+}
+
+// Seated pose is the layout's person; walk poses swing legs about the hip
+// and arms about the shoulder, each part a rigid box.
+void buildCrowdPoses()
+{
+    crowdPoseVertices.clear();
+    crowdPoseIndices.clear();
+
+    std::vector<uint32_t> indices;
+    for (int i = 0; i < LAYOUT_PART_COUNT; ++i)
+        if (layoutParts[i].object == OBJ_PERSON)
+            tessellatePart(crowdPoseVertices, crowdPoseIndices, layoutParts[i]);
+    crowdPoseVertexCount = (int)crowdPoseVertices.size();
+
+    const float DEG2RAD = 3.1415926f / 180.0f;
+    for (int k = 0; k < CROWD_WALK_POSES; ++k)
+    {
+        float swing = std::sin(2.0f * 3.1415926f * k / CROWD_WALK_POSES);
+        float leg = 25.0f * swing, arm = -20.0f * swing;
+        const float side[2] = { -1.0f, 1.0f };
+
+        // Same part order as the seated person: legs, torso, head, arms
+        std::vector<LayoutPart> parts;
+        for (int s = 0; s < 2; ++s)
+        {
+            float a = side[s] * leg * DEG2RAD;
+            LayoutPart p = { OBJ_PERSON, PART_BOX, 0, 0, 0, 0.1f, 0.1f, 0.3f,
+                             side[s] * 0.18f, 0.8f - 0.4f * std::cos(a), -0.05f - 0.4f * std::sin(a),
+                             0.0f, side[s] * leg, 0.12f, 0.8f, 0.12f };
+            parts.push_back(p);
+        }
+        LayoutPart torso = { OBJ_PERSON, PART_BOX, 0, 0, 0, 0.0f, 0.4f, 0.8f,
+                             0.0f, 1.15f, -0.05f, 0.0f, 0.0f, 0.45f, 0.7f, 0.25f };
+        LayoutPart head  = { OBJ_PERSON, PART_BOX, 0, 0, 0, 1.0f, 0.8f, 0.6f,
+                             0.0f, 1.68f, -0.05f, 0.0f, 0.0f, 0.30f, 0.35f, 0.30f };
+        parts.push_back(torso);
+        parts.push_back(head);
+        for (int s = 0; s < 2; ++s)
+        {
+            float a = side[s] * arm * DEG2RAD;
+            LayoutPart p = { OBJ_PERSON, PART_BOX, 0, 0, 0, 0.0f, 0.4f, 0.8f,
+                             side[s] * 0.32f, 1.4f - 0.2f * std::cos(a), -0.05f - 0.2f * std::sin(a),
+                             0.0f, side[s] * arm, 0.12f, 0.4f, 0.12f };
+            parts.push_back(p);
+        }
+
+        indices.clear();
+        for (size_t i = 0; i < parts.size(); ++i)
+            tessellatePart(crowdPoseVertices, indices, parts[i]);
+    }
+}
+
+void pickAgentDestination(Agent& a)
+{
+    int d = a.dest;
+    while (d == a.dest)
+        d = (int)(nextRandom(a.rng) % CROWD_DEST_COUNT);
+    a.dest  = d;
+    a.state = AGENT_WALKING;
+}
+
+void spawnCrowd(int count)
+{
+    crowdAgents.resize(count);
+    for (int n = 0; n < count; ++n)
+    {
+        Agent& a = crowdAgents[n];
+        a.rng = 0x9E3779B9u ^ (uint32_t)(n * 2654435761u);
+        nextRandom(a.rng);
+
+        // A free cell at random; the door if furniture covers the floor
+        if (navFreeCells.empty())
+        {
+            a.x = 0.0f;
+            a.z = ROOM_HALF_DEPTH - 0.2f;
+        }
+        else
+        {
+            int c = navFreeCells[nextRandom(a.rng) % (uint32_t)navFreeCells.size()];
+            a.x = navCenterX(c % NAV_W);
+            a.z = navCenterZ(c / NAV_W);
+        }
+        a.yawRad = randomUnit(a.rng) * 6.2831853f;
+        a.stride = randomUnit(a.rng);
+        a.timer  = 0.0f;
+        a.dest   = -1;
+        pickAgentDestination(a);
+    }
+}
+
+void stepAgent(Agent& a, float dt)
+{
+    const CrowdDestination& d = crowdDestinations[a.dest];
+    const FlowField&        f = crowdFields[a.dest];
+
+    if (a.state != AGENT_WALKING)
+    {
+        a.timer -= dt;
+        if (a.timer > 0.0f) return;
+        if (a.state == AGENT_AWAY)
+        {
+            // Re-enter through the door
+            a.x = (randomUnit(a.rng) - 0.5f) * 2.0f;
+            a.z = ROOM_HALF_DEPTH - 0.2f;
+        }
+        pickAgentDestination(a);
+        return;
+    }
+
+    int c = navCellZ(a.z) * NAV_W + navCellX(a.x);
+    if (f.cost[c] == 0.0f)
+    {
+        a.state = d.exit ? AGENT_AWAY : AGENT_DWELLING;
+        a.timer = d.exit ? 2.0f + 8.0f * randomUnit(a.rng) : 4.0f + 16.0f * randomUnit(a.rng);
+        if (d.sit) a.yawRad = std::atan2(a.x - crowdGoalX[a.dest], a.z - crowdGoalZ[a.dest]);
+        return;
+    }
+    if (f.cost[c] >= INF_COST)
+    {
+        // Stranded: furniture dropped on the agent moves it to the closest
+        // free cell; a free cell cut off from this goal tries another one,
+        // and one walled in from every goal re-enters through the door
+        if (navBlocked[c] && navNearestFree[c] >= 0)
+        {
+            a.x = navCenterX(navNearestFree[c] % NAV_W);
+            a.z = navCenterZ(navNearestFree[c] / NAV_W);
+            return;
+        }
+        bool reachable = false;
+        for (int k = 0; k < CROWD_DEST_COUNT && !reachable; ++k)
+            reachable = crowdFields[k].cost[c] < INF_COST;
+        if (!reachable)
+        {
+            a.x = (randomUnit(a.rng) - 0.5f) * 2.0f;
+            a.z = ROOM_HALF_DEPTH - 0.2f;
+        }
+        pickAgentDestination(a);
+        return;
+    }
+
+    float step = AGENT_SPEED * dt;
+    a.x += f.dirX[c] * step;
+    a.z += f.dirZ[c] * step;
+
+    // Turn toward the flow, at most ~8 degrees per tick
+    float target = std::atan2(-f.dirX[c], -f.dirZ[c]);
+    float turn = std::remainder(target - a.yawRad, 6.2831853f);
+    a.yawRad += std::max(-0.14f, std::min(0.14f, turn));
+
+    a.stride += step / 1.4f;   // one cycle per 1.4 m
+    a.stride -= std::floor(a.stride);
+}
+
+// Pose copy rotated about Y and moved to the agent; away agents collapse
+// to degenerate triangles so every agent keeps its fixed slot.
+void writeAgentFigure(const Agent& a, SceneVertex* out)
+{
+    if (a.state == AGENT_AWAY)
+    {
+        SceneVertex hidden = {};
+        std::fill(out, out + crowdPoseVertexCount, hidden);
+        return;
+    }
+
+    int pose = 0;
+    if (!(a.state == AGENT_DWELLING && crowdDestinations[a.dest].sit))
+        pose = 1 + (a.state == AGENT_WALKING ? (int)(a.stride * CROWD_WALK_POSES) % CROWD_WALK_POSES : 0);
+
+    const SceneVertex* src = &crowdPoseVertices[(size_t)pose * crowdPoseVertexCount];
+    float c = std::cos(a.yawRad), s = std::sin(a.yawRad);
+    for (int i = 0; i < crowdPoseVertexCount; ++i)
+    {
+        const SceneVertex& v = src[i];
+        SceneVertex& o = out[i];
+        o.px = c * v.px + s * v.pz + a.x;
+        o.py = v.py;
+        o.pz = -s * v.px + c * v.pz + a.z;
+        o.nx = c * v.nx + s * v.nz;
+        o.ny = v.ny;
+        o.nz = -s * v.nx + c * v.nz;
+        o.color = v.color;
+    }
+}
+
+void setCrowdEnabled(bool on)
+{
+    crowdEnabled = on;
+    if (!on) return;
+
+    if (crowdPoseVertices.empty()) buildCrowdPoses();
+    if (!navGridValid) rebuildNavigation();
+    if ((int)crowdAgents.size() != crowdAgentCount) spawnCrowd(crowdAgentCount);
+
+    size_t poseIndexCount = crowdPoseIndices.size();
+    crowdVertices.resize((size_t)crowdAgentCount * crowdPoseVertexCount);
+    crowdIndices.resize((size_t)crowdAgentCount * poseIndexCount);
+    for (int n = 0; n < crowdAgentCount; ++n)
+        for (size_t i = 0; i < poseIndexCount; ++i)
+            crowdIndices[(size_t)n * poseIndexCount + i] = crowdPoseIndices[i] + (uint32_t)(n * crowdPoseVertexCount);
+    crowdIboAgents = -1;   // re-upload indices
+
+    for (int n = 0; n < crowdAgentCount; ++n)
+        writeAgentFigure(crowdAgents[n], &crowdVertices[(size_t)n * crowdPoseVertexCount]);
+    crowdVerticesDirty = true;
+    ++crowdTick;
+
+    std::printf("Occupancy: %d agents, %d destinations\n", crowdAgentCount, CROWD_DEST_COUNT);
+}
+
+void setCrowdAgentCount(int count)
+{
+    crowdAgentCount = std::max(16, std::min(CROWD_MAX_AGENTS, count));
+    if (crowdEnabled) setCrowdEnabled(true);
+}
+
+// One tick: agents and their figures, CROWD_CHUNK agents per job
+void stepCrowd()
+{
+    if (!crowdEnabled) return;
+    if (!navGridValid) rebuildNavigation();
+
+    int count  = (int)crowdAgents.size();
+    int chunks = (count + CROWD_CHUNK - 1) / CROWD_CHUNK;
+    parallelFor(chunks, [count](int chunk)
+    {
+        int end = std::min(count, (chunk + 1) * CROWD_CHUNK);
+        for (int n = chunk * CROWD_CHUNK; n < end; ++n)
+        {
+            stepAgent(crowdAgents[n], CROWD_TICK_SEC);
+            writeAgentFigure(crowdAgents[n], &crowdVertices[(size_t)n * crowdPoseVertexCount]);
+        }
+    });
+    crowdVerticesDirty = true;
+    ++crowdTick;
+}
+
+void drawCrowd3D()
+{
+    if (!crowdEnabled || crowdAgents.empty()) return;
+
+    const char*     vertexBase = (const char*)&crowdVertices[0];
+    const uint32_t* indexBase  = &crowdIndices[0];
+    if (hasBufferObjects)
+    {
+        if (!crowdVbo) pglGenBuffers(1, &crowdVbo);
+        if (!crowdIbo) pglGenBuffers(1, &crowdIbo);
+        pglBindBuffer(GL_ARRAY_BUFFER, crowdVbo);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, crowdIbo);
+        if (crowdVerticesDirty)
+            pglBufferData(GL_ARRAY_BUFFER, crowdVertices.size() * sizeof(SceneVertex),
+                          &crowdVertices[0], GL_STREAM_DRAW);
+        if (crowdIboAgents != (int)crowdAgents.size())
+        {
+            pglBufferData(GL_ELEMENT_ARRAY_BUFFER, crowdIndices.size() * sizeof(uint32_t),
+                          &crowdIndices[0], GL_STATIC_DRAW);
+            crowdIboAgents = (int)crowdAgents.size();
+        }
+        vertexBase = nullptr;
+        indexBase  = nullptr;
+    }
+    crowdVerticesDirty = false;
+
+    setSceneVertexPointers(vertexBase);
+    ++frameStats.drawCalls;
+    glDrawElements(GL_TRIANGLES, (GLsizei)crowdIndices.size(), GL_UNSIGNED_INT, indexBase);
+    clearSceneVertexPointers();
+}
+
+// --------------------------------------------------
+// LIGHTING
+// --------------------------------------------------
+void setupLighting()
+{
+    glEnable(GL_LIGHTING);
+    glEnable(GL_LIGHT0);
+
+    GLfloat lightPos[] = { 0.0f, ROOM_HEIGHT - 0.1f, -2.0f, 1.0f };
+    GLfloat amb[]      = { 0.25f, 0.25f, 0.30f, 1.0f };
+    GLfloat diff[]     = { 0.9f, 0.9f, 0.9f, 1.0f };
+    GLfloat spec[]     = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
+    glLightfv(GL_LIGHT0, GL_AMBIENT,  amb);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE,  diff);
+    glLightfv(GL_LIGHT0, GL_SPECULAR, spec);
+
+    glEnable(GL_COLOR_MATERIAL);
+    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+    glShadeModel(GL_SMOOTH);
+}
+
+// --------------------------------------------------
+// ANIMATION STEP – FAN + DOOR + OCCUPANCY (one 16 ms tick)
+// --------------------------------------------------
+void stepAnimation()
+{
+    // Fan spin (uses adjustable speed)
+    fanAngleDeg += fanSpeedDeg;
+    if (fanAngleDeg >= 360.0f) fanAngleDeg -= 360.0f;
+
+    // Door animation
+    float targetAngle = doorOpen ? DOOR_MAX_ANGLE : 0.0f;
+    float diff = targetAngle - doorAngleDeg;
+    float step = 3.0f;
+
+    if (std::fabs(diff) > 0.1f)
+        doorAngleDeg += (diff > 0 ? step : -step);
+
+    stepCrowd();
+}
+
+// --------------------------------------------------
+// CAMERA PATH (record / script) + FRAME CAPTURE
+// --------------------------------------------------
+// A path is a list of timed poses, one per line: "t x y z yawDeg pitchDeg".
+// Recording stores one key per simulation tick; hand-written scripts can
+// use sparse keys, which are interpolated linearly.
+struct CameraKey
+{
+    float t;
+    float x, y, z;
+    float yawDeg, pitchDeg;
+};
+
+std::vector<CameraKey> cameraPath;
+bool recordingPath = false;
+int  recordTick    = 0;
+
+const char* CAMERA_PATH_FILE = "camera_path.txt";
+const char* CAPTURE_DIR      = "capture";
+const int   CAPTURE_FPS      = 60;  // one animation tick per frame
+const int   CAPTURE_MAX_SIZE = 8192;  // per side; keeps w*h*4 well inside an int
+const int   PBO_RING_SIZE    = 3;
+const int   MAX_QUEUED_FRAMES = 8;  // encoder backlog before capture waits
+
+struct CaptureState
+{
+    bool        active;
+    bool        exitWhenDone;
+    std::string outDir;
+    int         width, height;
+    int         frame;       // next frame to render
+    int         frameCount;
+    int         savedWidth, savedHeight;
+    bool        saved3DMode;  // view and camera to hand back when done
+    float       savedCam[5];  // x, y, z, yaw, pitch
+    GLuint      pbo[PBO_RING_SIZE];
+    GLuint      fbo, colorRb, depthRb;
+    std::chrono::steady_clock::time_point start;
+};
+
+CaptureState capture = {};
+
+bool saveCameraPath(const char* path)
+{
+    FILE* f = std::fopen(path, "w");
+    if (!f) return false;
+
+    std::fprintf(f, "# t x y z yawDeg pitchDeg\n");
+    for (size_t i = 0; i < cameraPath.size(); ++i)
+    {
+        const CameraKey& k = cameraPath[i];
+        std::fprintf(f, "%.4f %.4f %.4f %.4f %.3f %.3f\n", k.t, k.x, k.y, k.z, k.yawDeg, k.pitchDeg);
+    }
+    std::fclose(f);
+    return true;
+}
+
+bool loadCameraPath(const char* path)
+{
+    FILE* f = std::fopen(path, "r");
+    if (!f) return false;
+
+    cameraPath.clear();
+    char line[256];
+    while (std::fgets(line, sizeof(line), f))
+    {
+        CameraKey k;
+        if (line[0] == '#') continue;
+        if (std::sscanf(line, "%f %f %f %f %f %f", &k.t, &k.x, &k.y, &k.z, &k.yawDeg, &k.pitchDeg) == 6)
+            cameraPath.push_back(k);
+    }
+    std::fclose(f);
+
+    std::sort(cameraPath.begin(), cameraPath.end(),
+              [](const CameraKey& a, const CameraKey& b) { return a.t < b.t; });
+    return !cameraPath.empty();
+}
+
+void recordCameraKey()
+{
+    CameraKey k = { recordTick / (float)CAPTURE_FPS, camX, camY, camZ, camYawDeg, camPitchDeg };
+    cameraPath.push_back(k);
+    ++recordTick;
+}
+
+void toggleRecording()
+{
+    recordingPath = !recordingPath;
+    if (recordingPath)
+    {
+        cameraPath.clear();
+        recordTick = 0;
+        std::printf("Recording camera path...\n");
+    }
+    else if (saveCameraPath(CAMERA_PATH_FILE))
+    {
+        std::printf("Saved %d keys to %s\n", (int)cameraPath.size(), CAMERA_PATH_FILE);
+    }
+}
+
+void applyCameraPath(float t)
+{
+    std::vector<CameraKey>::const_iterator hi =
+        std::upper_bound(cameraPath.begin(), cameraPath.end(), t,
+                         [](float v, const CameraKey& k) { return v < k.t; });
+
+    CameraKey k;
+    if (hi == cameraPath.begin())    k = cameraPath.front();
+    else if (hi == cameraPath.end()) k = cameraPath.back();
+    else
+    {
+        const CameraKey& a = *(hi - 1);
+        const CameraKey& b = *hi;
+        float u = (b.t > a.t) ? (t - a.t) / (b.t - a.t) : 0.0f;
+        k.x        = a.x        + (b.x        - a.x)        * u;
+        k.y        = a.y        + (b.y        - a.y)        * u;
+        k.z        = a.z        + (b.z        - a.z)        * u;
+        k.yawDeg   = a.yawDeg   + (b.yawDeg   - a.yawDeg)   * u;
+        k.pitchDeg = a.pitchDeg + (b.pitchDeg - a.pitchDeg) * u;
+    }
+
+    camX = k.x; camY = k.y; camZ = k.z;
+    camYawDeg = k.yawDeg; camPitchDeg = k.pitchDeg;
+}
+
+// Runs on a worker: GL rows are bottom-up RGBA, PPM wants top-down RGB
+void writeFramePPM(const std::string& path, int w, int h, const std::vector<unsigned char>& rgba)
+{
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return;
+
+    std::fprintf(f, "P6\n%d %d\n255\n", w, h);
+    std::vector<unsigned char> row(w * 3);
+    for (int y = h - 1; y >= 0; --y)
+    {
+        const unsigned char* src = &rgba[(size_t)y * w * 4];
+        for (int x = 0; x < w; ++x)
+        {
+            row[x * 3 + 0] = src[x * 4 + 0];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + 2];
+        }
+        std::fwrite(&row[0], 1, row.size(), f);
+    }
+    std::fclose(f);
+}
+
+void queueFrameEncode(int frame, std::vector<unsigned char>& rgba)
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "/frame_%05d.ppm", frame);
+    std::string path = capture.outDir + name;
+    int w = capture.width, h = capture.height;
+
+    // Backpressure: bound memory if encoders fall behind
+    waitForJobs(MAX_QUEUED_FRAMES);
+
+    std::shared_ptr<std::vector<unsigned char> > pixels(new std::vector<unsigned char>());
+    pixels->swap(rgba);
+    submitJob([path, w, h, pixels] { writeFramePPM(path, w, h, *pixels); });
+}
+
+// Maps the PBO written PBO_RING_SIZE-1 frames ago; by now the DMA is done
+void collectCapturedFrame(int frame)
+{
+    std::vector<unsigned char> rgba((size_t)capture.width * capture.height * 4);
+
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo[frame % PBO_RING_SIZE]);
+    const void* src = pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (src)
+    {
+        std::memcpy(&rgba[0], src, rgba.size());
+        pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    queueFrameEncode(frame, rgba);
+}
+
+void renderScene();
+
+// Color + depth renderbuffers behind an FBO; false if unsupported/incomplete
+bool createOffscreenTarget(int width, int height, GLuint& fbo, GLuint& colorRb, GLuint& depthRb)
+{
+    fbo = 0;
+    if (!hasFramebuffers) return false;
+
+    pglGenFramebuffers(1, &fbo);
+    pglGenRenderbuffers(1, &colorRb);
+    pglGenRenderbuffers(1, &depthRb);
+
+    pglBindRenderbuffer(GL_RENDERBUFFER, colorRb);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    pglBindRenderbuffer(GL_RENDERBUFFER, depthRb);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRb);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, depthRb);
+    bool complete = pglCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!complete)
+    {
+        pglDeleteFramebuffers(1, &fbo);
+        pglDeleteRenderbuffers(1, &colorRb);
+        pglDeleteRenderbuffers(1, &depthRb);
+        fbo = 0;
+    }
+    return complete;
+}
+
+void destroyOffscreenTarget(GLuint& fbo, GLuint& colorRb, GLuint& depthRb)
+{
+    if (!fbo) return;
+    pglDeleteFramebuffers(1, &fbo);
+    pglDeleteRenderbuffers(1, &colorRb);
+    pglDeleteRenderbuffers(1, &depthRb);
+    fbo = 0;
+}
+
+bool startCapture(const char* pathFile, const char* outDir, int width, int height, bool exitWhenDone)
+{
+    if (capture.active) return false;
+    if (!loadCameraPath(pathFile))
+    {
+        std::printf("Capture: no camera path in %s (press R to record one)\n", pathFile);
+        return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(outDir, ec);
+
+    capture.active       = true;
+    capture.exitWhenDone = exitWhenDone;
+    capture.outDir       = outDir;
+    capture.width        = width;
+    capture.height       = height;
+    capture.frame        = 0;
+    capture.frameCount   = (int)std::ceil(cameraPath.back().t * CAPTURE_FPS) + 1;
+    capture.savedWidth   = gWindowWidth;
+    capture.savedHeight  = gWindowHeight;
+    capture.saved3DMode  = is3DMode;
+    capture.savedCam[0]  = camX;
+    capture.savedCam[1]  = camY;
+    capture.savedCam[2]  = camZ;
+    capture.savedCam[3]  = camYawDeg;
+    capture.savedCam[4]  = camPitchDeg;
+
+    // Offscreen target so capture size and speed don't depend on the window
+    if (!createOffscreenTarget(width, height, capture.fbo, capture.colorRb, capture.depthRb))
+    {
+        // Back buffer fallback is limited to the window size
+        capture.width  = std::min(width,  gWindowWidth);
+        capture.height = std::min(height, gWindowHeight);
+    }
+
+    if (hasBufferObjects)
+    {
+        pglGenBuffers(PBO_RING_SIZE, capture.pbo);
+        for (int i = 0; i < PBO_RING_SIZE; ++i)
+        {
+            pglBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo[i]);
+            pglBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)capture.width * capture.height * 4,
+                          nullptr, GL_STREAM_READ);
+        }
+        pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // Deterministic start: same animation state every run
+    fanAngleDeg  = 0.0f;
+    doorAngleDeg = doorOpen ? DOOR_MAX_ANGLE : 0.0f;
+    is3DMode     = true;
+
+    capture.start = std::chrono::steady_clock::now();
+    std::printf("Capturing %d frames (%dx%d) to %s/\n",
+                capture.frameCount, capture.width, capture.height, outDir);
+    return true;
+}
+
+void finishCapture()
+{
+    if (hasBufferObjects)
+        pglDeleteBuffers(PBO_RING_SIZE, capture.pbo);
+    destroyOffscreenTarget(capture.fbo, capture.colorRb, capture.depthRb);
+
+    gWindowWidth  = capture.savedWidth;
+    gWindowHeight = capture.savedHeight;
+    glViewport(0, 0, gWindowWidth, gWindowHeight);
+    is3DMode    = capture.saved3DMode;
+    camX        = capture.savedCam[0];
+    camY        = capture.savedCam[1];
+    camZ        = capture.savedCam[2];
+    camYawDeg   = capture.savedCam[3];
+    camPitchDeg = capture.savedCam[4];
+    capture.active = false;
+
+    waitForJobs(0);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - capture.start).count();
+    std::printf("Captured %d frames in %.2f s (%.1f fps, %.2fx real time)\n",
+                capture.frameCount, secs, capture.frameCount / secs,
+                (capture.frameCount / (double)CAPTURE_FPS) / secs);
+    std::printf("Encode with: ffmpeg -framerate %d -i %s/frame_%%05d.ppm walkthrough.mp4\n",
+                CAPTURE_FPS, capture.outDir.c_str());
+
+    if (capture.exitWhenDone) std::exit(0);
+}
+
+// Idle callback while capturing: render frame N, read it into PBO N%ring,
+// then collect frame N-(ring-1) whose transfer has had time to finish.
+void captureIdle()
+{
+    if (!capture.active) return;
+
+    int f = capture.frame;
+    if (f < capture.frameCount)
+    {
+        applyCameraPath(f / (float)CAPTURE_FPS);
+        if (f > 0) stepAnimation();
+
+        gWindowWidth  = capture.width;
+        gWindowHeight = capture.height;
+        if (capture.fbo) pglBindFramebuffer(GL_FRAMEBUFFER, capture.fbo);
+        glViewport(0, 0, capture.width, capture.height);
+
+        renderScene();
+
+        glReadBuffer(capture.fbo ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+        if (hasBufferObjects)
+        {
+            pglBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo[f % PBO_RING_SIZE]);
+            glReadPixels(0, 0, capture.width, capture.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+            pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+        else
+        {
+            std::vector<unsigned char> rgba((size_t)capture.width * capture.height * 4);
+            glReadPixels(0, 0, capture.width, capture.height, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+            queueFrameEncode(f, rgba);
+        }
+        if (capture.fbo) pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    int ready = f - (PBO_RING_SIZE - 1);
+    if (hasBufferObjects && ready >= 0 && ready < capture.frameCount)
+        collectCapturedFrame(ready);
+
+    ++capture.frame;
+    if (capture.frame >= capture.frameCount + (hasBufferObjects ? PBO_RING_SIZE - 1 : 0))
+    {
+        glutIdleFunc(nullptr);
+        finishCapture();
+    }
+    glutPostRedisplay();
+}
+
+void beginCapture(const char* pathFile, const char* outDir, int width, int height, bool exitWhenDone)
+{
+    if (startCapture(pathFile, outDir, width, height, exitWhenDone))
+        glutIdleFunc(captureIdle);
+}
+
+// --------------------------------------------------
+// DISPLAY
+// --------------------------------------------------
+// Plan framing: native plan pixels (scale 0, the single view) or the
+// export extent scaled to fit and centred in the view
+struct PlanFraming
+{
+    double scale;
+    int    x, y, w, h;   // image rect in the view
+};
+
+PlanFraming planFraming(int w, int h, bool native)
+{
+    PlanFraming f = { 0.0, 0, 0, w, h };
+    if (native) return f;
+
+    int ew = PLAN_EXTENT_MAX_X - PLAN_EXTENT_MIN_X, eh = PLAN_EXTENT_MAX_Y - PLAN_EXTENT_MIN_Y;
+    f.scale = std::min(w / (double)ew, h / (double)eh);
+    f.w = std::max(1, std::min(w, (int)std::lround(ew * f.scale)));
+    f.h = std::max(1, std::min(h, (int)std::lround(eh * f.scale)));
+    f.x = (w - f.w) / 2;
+    f.y = (h - f.h) / 2;
+    return f;
+}
+
+// View pixel (origin bottom-left) -> plan space
+void viewToPlan(const PlanFraming& f, int x, int y, float& px, float& py)
+{
+    if (f.scale == 0.0)
+    {
+        px = (float)x;
+        py = (float)y;
+        return;
+    }
+    px = (float)(PLAN_EXTENT_MIN_X + (x - f.x) / f.scale);
+    py = (float)(PLAN_EXTENT_MIN_Y + (y - f.y) / f.scale);
+}
+
+// Everything buildOfficePlan2D and addSelectionHighlight2D read: the
+// toggles, the selection and the furniture moves
+uint64_t planStateHash()
+{
+    int state[5 + 2 * PLAN_FURNITURE_COUNT];
+    state[0] = showDoor2D;
+    state[1] = showWindows2D;
+    state[2] = showTable2D;
+    state[3] = showFootprints2D;
+    state[4] = selectedObject;
+    for (int i = 0; i < PLAN_FURNITURE_COUNT; ++i)
+    {
+        state[5 + 2 * i]     = planMoveX[i];
+        state[5 + 2 * i + 1] = planMoveY[i];
+    }
+    return hashBytes(state, sizeof(state));
+}
+
+// The primitives are rebuilt only when the plan state or framing changed
+void drawPlanView(int w, int h, const PlanFraming& f)
+{
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0, w, 0, h);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    uint64_t state = hashBytes(&f.scale, sizeof(f.scale), planStateHash());
+    if (state != planPrimsState)
+    {
+        buildOfficePlan2D();
+        addSelectionHighlight2D();
+        if (f.scale != 0.0) scalePlanPrimitives(planPrims, planPolyVerts, f.scale);
+        planPrimsState = state;
+    }
+    drawOfficePlan2D(f.x, f.y, f.w, f.h);
+}
+
+void drawSceneObjects3D(float fanAngle)
+{
+    drawRoomAndObjects3D(fanAngle);
+    drawCrowd3D();
+    drawSelectionHighlight3D();
+}
+
+// The FPS camera. Lights go in after the view matrix so they stay in
+// world space whichever view drew last.
+void drawPerspectiveView(int w, int h)
+{
+    glEnable(GL_DEPTH_TEST);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(CAM_FOVY_DEG, (double)w / (double)h, 0.1, 100.0);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    // Camera direction from yaw/pitch
+    float dirX, dirY, dirZ;
+    cameraForward(dirX, dirY, dirZ);
+
+    gluLookAt(camX, camY, camZ,
+              camX + dirX, camY + dirY, camZ + dirZ,
+              0.0f, 1.0f, 0.0f);
+    setupLighting();
+
+    drawSceneObjects3D(fanAngleDeg);
+}
+
+// Front elevation: orthographic, looking towards the back wall from a cut
+// just inside the front wall, so the front wall and door are left out
+const float ELEVATION_CUT_Z  = ROOM_HALF_DEPTH - 0.1f;
+const float ELEVATION_MARGIN = 0.5f;   // m around the room section
+
+void elevationExtent(int w, int h, float& halfW, float& halfH)
+{
+    halfW = ROOM_HALF_WIDTH + ELEVATION_MARGIN;
+    halfH = ROOM_HEIGHT * 0.5f + ELEVATION_MARGIN;
+    float aspect = (float)w / (float)h;
+    if (halfW / halfH > aspect) halfH = halfW / aspect;
+    else                        halfW = halfH * aspect;
+}
+
+void drawElevationView(int w, int h)
+{
+    float halfW, halfH;
+    elevationExtent(w, h, halfW, halfH);
+    glEnable(GL_DEPTH_TEST);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-halfW, halfW, -halfH, halfH, 0.0, 2.0 * ROOM_HALF_DEPTH + 1.0);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(0.0, ROOM_HEIGHT * 0.5, ELEVATION_CUT_Z,
+              0.0, ROOM_HEIGHT * 0.5, ELEVATION_CUT_Z - 1.0,
+              0.0, 1.0, 0.0);
+    setupLighting();
+
+    // Like a drawn section, the elevation shows the fan at rest, so the
+    // spinning blades don't make it re-render every tick
+    drawSceneObjects3D(0.0f);
+}
+
+// The single view (V switches plan / 3D), into the current framebuffer
+void renderScene()
+{
+    frameStats.drawCalls = 0;
+    frameStats.culledObjects = 0;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (!is3DMode)
+        drawPlanView(gWindowWidth, gWindowHeight, planFraming(gWindowWidth, gWindowHeight, true));
+    else
+        drawPerspectiveView(gWindowWidth, gWindowHeight);
+}
+
+// --------------------------------------------------
+// VIEWS (split screen / separate windows over one scene)
+// --------------------------------------------------
+// Plan, 3D perspective and front elevation all draw the same scene: the
+// scene and crowd buffers and the plan buffer exist once, and extra
+// windows share the main window's GL context. With more than one view,
+// each caches its last image in its own framebuffer, keyed by a hash of
+// the inputs it shows, and re-renders (culling for its own camera) only
+// when that hash changes; otherwise the window just blits the cached
+// image. An idle frame is one blit per view, but anything animating in a
+// view re-renders it every tick: the spinning fan (the perspective only;
+// keys 7/8/9/0 set its speed or stop it), a swinging door, and the
+// running crowd. The single view draws straight to the window, where a
+// cache would only add a blit.
+enum ViewKind   { VIEW_PLAN, VIEW_PERSPECTIVE, VIEW_ELEVATION, VIEW_KIND_COUNT };
+enum ViewLayout { LAYOUT_SINGLE, LAYOUT_SPLIT, LAYOUT_WINDOWS, VIEW_LAYOUT_COUNT };
+
+const char* VIEW_NAMES[VIEW_KIND_COUNT]          = { "Plan", "3D perspective", "Front elevation" };
+const char* VIEW_LAYOUT_NAMES[VIEW_LAYOUT_COUNT] = { "single view", "split screen", "separate windows" };
+const int   VIEW_GUTTER = 2;   // px between split-screen views
+
+struct View
+{
+    int      window;                     // GLUT window id, 0 = not shown
+    int      x, y, w, h;                 // in the window, origin bottom-left
+    uint64_t inputsHash;                 // inputs of the cached image
+    GLuint   fbo, colorRb, depthRb;      // the cached image
+    int      fboW, fboH;
+    int      drawCalls, culledObjects;   // of its last render
+    int      renders;                    // renders so far (a cached frame adds none)
+};
+
+struct ViewWindow
+{
+    int id, w, h;
+};
+
+View       views[VIEW_KIND_COUNT] = {};
+ViewLayout viewLayout = LAYOUT_SINGLE;
+int        mainWindow = 0;
+ViewWindow viewWindows[VIEW_KIND_COUNT] = {};   // LAYOUT_WINDOWS: 3D views' own windows
+
+void placeView(ViewKind kind, int window, int x, int y, int w, int h)
+{
+    View& v = views[kind];
+    v.window = window;
+    v.x = x;
+    v.y = y;
+    v.w = std::max(1, w);
+    v.h = std::max(1, h);
+}
+
+// Where each view goes for the current layout and window sizes
+void layoutViews()
+{
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k) views[k].window = 0;
+
+    int w = gWindowWidth, h = gWindowHeight;
+    switch (viewLayout)
+    {
+    case LAYOUT_SINGLE:
+        placeView(is3DMode ? VIEW_PERSPECTIVE : VIEW_PLAN, mainWindow, 0, 0, w, h);
+        break;
+
+    case LAYOUT_SPLIT:
+    {
+        // Plan on the left; perspective over elevation on the right
+        int left = (w - VIEW_GUTTER) / 2, right = w - left - VIEW_GUTTER;
+        int lower = (h - VIEW_GUTTER) / 2, upper = h - lower - VIEW_GUTTER;
+        placeView(VIEW_PLAN,        mainWindow, 0,                  0,                   left,  h);
+        placeView(VIEW_PERSPECTIVE, mainWindow, left + VIEW_GUTTER, lower + VIEW_GUTTER, right, upper);
+        placeView(VIEW_ELEVATION,   mainWindow, left + VIEW_GUTTER, 0,                   right, lower);
+        break;
+    }
+
+    case LAYOUT_WINDOWS:
+        placeView(VIEW_PLAN, mainWindow, 0, 0, w, h);
+        for (int k = VIEW_PERSPECTIVE; k < VIEW_KIND_COUNT; ++k)
+            if (viewWindows[k].id)
+                placeView((ViewKind)k, viewWindows[k].id, 0, 0, viewWindows[k].w, viewWindows[k].h);
+        break;
+
+    default:
+        break;
+    }
+}
+
+PlanFraming viewPlanFraming(const View& v)
+{
+    return planFraming(v.w, v.h, viewLayout == LAYOUT_SINGLE);
+}
+
+// Everything a view's image depends on; zeroed first so padding hashes the same
+struct ViewInputs
+{
+    int      kind, w, h, nativePlan;
+    int      selected;
+    uint64_t plan;                 // plan: planStateHash (toggles, selection, moves)
+    uint32_t sceneEdit, crowdTick;
+    int      crowdOn, culling;
+    float    door, fan;
+    float    camera[5];            // perspective only
+};
+
+uint64_t viewInputsHash(ViewKind kind)
+{
+    const View& v = views[kind];
+    ViewInputs in;
+    std::memset(&in, 0, sizeof(in));
+    in.kind     = kind;
+    in.w        = v.w;
+    in.h        = v.h;
+    in.selected = selectedObject;
+
+    if (kind == VIEW_PLAN)
+    {
+        in.plan       = planStateHash();
+        in.nativePlan = viewLayout == LAYOUT_SINGLE;
+    }
+    else
+    {
+        in.sceneEdit = sceneEditVersion;
+        in.crowdOn   = crowdEnabled;
+        in.crowdTick = crowdEnabled ? crowdTick : 0;
+        in.culling   = occlusionCulling;
+        in.door      = doorAngleDeg;
+        if (kind == VIEW_PERSPECTIVE)
+        {
+            in.fan       = fanAngleDeg;   // the elevation draws it at rest
+            in.camera[0] = camX;      in.camera[1] = camY; in.camera[2] = camZ;
+            in.camera[3] = camYawDeg; in.camera[4] = camPitchDeg;
+        }
+    }
+    return hashBytes(&in, sizeof(in));
+}
+
+// Draws the view at the current viewport (not cleared here)
+void renderView(ViewKind kind)
+{
+    View& v = views[kind];
+    frameStats.drawCalls = 0;
+    frameStats.culledObjects = 0;
+
+    switch (kind)
+    {
+    case VIEW_PLAN:        drawPlanView(v.w, v.h, viewPlanFraming(v)); break;
+    case VIEW_PERSPECTIVE: drawPerspectiveView(v.w, v.h);              break;
+    case VIEW_ELEVATION:   drawElevationView(v.w, v.h);                break;
+    default:                                                           break;
+    }
+    v.drawCalls     = frameStats.drawCalls;
+    v.culledObjects = frameStats.culledObjects;
+    ++v.renders;
+}
+
+// Re-renders the view's cached image if its inputs changed; false when it
+// can't be cached (no FBO / blit support) and must be drawn directly
+bool updateViewCache(ViewKind kind)
+{
+    View& v = views[kind];
+    if (!hasFramebufferBlit) return false;
+
+    uint64_t inputs = viewInputsHash(kind);
+    if (v.fbo && v.fboW == v.w && v.fboH == v.h && v.inputsHash == inputs) return true;
+
+    if (!v.fbo || v.fboW != v.w || v.fboH != v.h)
+    {
+        destroyOffscreenTarget(v.fbo, v.colorRb, v.depthRb);
+        if (!createOffscreenTarget(v.w, v.h, v.fbo, v.colorRb, v.depthRb)) return false;
+        v.fboW = v.w;
+        v.fboH = v.h;
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, v.fbo);
+    glViewport(0, 0, v.w, v.h);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderView(kind);
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    v.inputsHash = inputs;
+    return true;
+}
+
+// Every view placed in window, into its default framebuffer (w x h).
+// frameStats gets this frame's draw calls (those of views re-rendered
+// this frame, plus a blit per cached view) and the views' culled objects.
+void drawWindowViews(int window, int w, int h)
+{
+    glViewport(0, 0, w, h);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    int drawCalls = 0, culled = 0;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+    {
+        View& v = views[k];
+        if (v.window != window) continue;
+
+        int renders = v.renders;
+        if (viewLayout != LAYOUT_SINGLE && updateViewCache((ViewKind)k))
+        {
+            pglBindFramebuffer(GL_READ_FRAMEBUFFER, v.fbo);
+            pglBlitFramebuffer(0, 0, v.w, v.h, v.x, v.y, v.x + v.w, v.y + v.h,
+                               GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            pglBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+            drawCalls += 1 + (v.renders != renders ? v.drawCalls : 0);
+        }
+        else
+        {
+            glViewport(v.x, v.y, v.w, v.h);
+            glScissor(v.x, v.y, v.w, v.h);
+            glEnable(GL_SCISSOR_TEST);
+            renderView((ViewKind)k);
+            glDisable(GL_SCISSOR_TEST);
+            drawCalls += v.drawCalls;
+        }
+        culled += v.culledObjects;
+    }
+    frameStats.drawCalls     = drawCalls;
+    frameStats.culledObjects = culled;
+    glViewport(0, 0, w, h);
+}
+
+// Every window showing a view
+void postViewRedisplay()
+{
+    if (mainWindow) glutPostWindowRedisplay(mainWindow);
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        if (views[k].window && views[k].window != mainWindow)
+            glutPostWindowRedisplay(views[k].window);
+}
+
+int viewWindowHeight(int window)
+{
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        if (viewWindows[k].id && viewWindows[k].id == window) return viewWindows[k].h;
+    return gWindowHeight;
+}
+
+// View under window pixel (mouseX, mouseY) (GLUT: origin top-left), with
+// the pixel in view coords (origin bottom-left); -1 if none
+int viewAt(int window, int mouseX, int mouseY, int& x, int& y)
+{
+    int wy = viewWindowHeight(window) - 1 - mouseY;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+    {
+        const View& v = views[k];
+        if (v.window != window || !window) continue;
+        if (mouseX >= v.x && mouseX < v.x + v.w && wy >= v.y && wy < v.y + v.h)
+        {
+            x = mouseX - v.x;
+            y = wy - v.y;
+            return k;
+        }
+    }
+    return -1;
+}
+
+int pickInView(ViewKind kind, int x, int y)
+{
+    const View& v = views[kind];
+    switch (kind)
+    {
+    case VIEW_PLAN:
+    {
+        float px, py;
+        viewToPlan(viewPlanFraming(v), x, y, px, py);
+        return pickPlanPoint(px, py);
+    }
+    case VIEW_PERSPECTIVE:
+        return pickPerspective(x, v.h - 1 - y, v.w, v.h);
+    case VIEW_ELEVATION:
+    {
+        // Straight into the room from the cut plane
+        float halfW, halfH;
+        elevationExtent(v.w, v.h, halfW, halfH);
+        float origin[3] = { ((x + 0.5f) / v.w * 2.0f - 1.0f) * halfW,
+                            ROOM_HEIGHT * 0.5f + ((y + 0.5f) / v.h * 2.0f - 1.0f) * halfH,
+                            ELEVATION_CUT_Z };
+        float dir[3] = { 0.0f, 0.0f, -1.0f };
+        return pickRay(origin, dir);
+    }
+    default:
+        return -1;
+    }
+}
+
+// ---------- Plan drag (furniture follows in every view) ----------
+int   dragItem = -1;               // PlanFurniture being dragged, -1 = none
+float dragStartX, dragStartY;      // plan space
+int   dragStartMoveX, dragStartMoveY;
+
+// Starts a drag when pickIndex is a plan-movable item under the plan view
+void beginPlanDrag(int pickIndex, int x, int y)
+{
+    dragItem = -1;
+    if (pickIndex < 0) return;
+    for (int g = 0; g < PLAN_FURNITURE_COUNT; ++g)
+        if (std::strcmp(furnitureGroups[g].names[0], pickObjects[pickIndex].name) == 0)
+            dragItem = furnitureGroups[g].item;
+    if (dragItem < 0) return;
+
+    viewToPlan(viewPlanFraming(views[VIEW_PLAN]), x, y, dragStartX, dragStartY);
+    dragStartMoveX = planMoveX[dragItem];
+    dragStartMoveY = planMoveY[dragItem];
+}
+
+// Moves the dragged item to follow the plan-view pixel (x, y), kept
+// inside the room outline
+void updatePlanDrag(int x, int y)
+{
+    if (dragItem < 0) return;
+
+    float px, py;
+    viewToPlan(viewPlanFraming(views[VIEW_PLAN]), x, y, px, py);
+    int moveX = dragStartMoveX + (int)std::lround(px - dragStartX);
+    int moveY = dragStartMoveY + (int)std::lround(py - dragStartY);
+
+    for (size_t i = 0; i < pickObjects.size(); ++i)
+    {
+        const PickObject& o = pickObjects[i];
+        if (std::strcmp(o.name, furnitureGroups[dragItem].names[0]) != 0) continue;
+
+        float baseX = o.px - planMoveX[dragItem], baseY = o.py - planMoveY[dragItem];
+        int loX = (int)std::ceil(PLAN_ROOM_MIN_X + o.phx - baseX), hiX = (int)std::floor(PLAN_ROOM_MAX_X - o.phx - baseX);
+        int loY = (int)std::ceil(PLAN_ROOM_MIN_Y + o.phy - baseY), hiY = (int)std::floor(PLAN_ROOM_MAX_Y - o.phy - baseY);
+        moveX = std::max(loX, std::min(hiX, moveX));
+        moveY = std::max(loY, std::min(hiY, moveY));
+    }
+    if (moveX == planMoveX[dragItem] && moveY == planMoveY[dragItem]) return;
+
+    planMoveX[dragItem] = moveX;
+    planMoveY[dragItem] = moveY;
+    applyFurnitureMoves();
+}
+
+// The crowd re-plans once the drop is final
+void endPlanDrag()
+{
+    if (dragItem < 0) return;
+
+    float dx, dz;
+    furnitureOffset(furnitureGroups[dragItem].names[0], dx, dz);
+    std::printf("Moved %s by (%.2f, %.2f) m\n", furnitureGroups[dragItem].names[0], dx, dz);
+    if (navGridValid) rebuildNavigation();
+    dragItem = -1;
+}
+
+// --------------------------------------------------
+// KEYBOARD (PRESS)
+// --------------------------------------------------
+void setViewLayout(ViewLayout layout);
+
+void handleKeyDown(unsigned char key)
+{
+    switch (key)
+    {
+    case 27: // ESC
+        std::exit(0);
 
     case 'v': case 'V':
         is3DMode = !is3DMode;
         firstMouse = true; // reset mouse delta
         break;
 
-    // ---------- 2D toggles ----------
-    case '1': showDoor2D    = !showDoor2D;    break;
-    case '2': showWindows2D = !showWindows2D; break;
-    case '3': showTable2D   = !showTable2D;   break;
+    // ---------- View layout: single -> split screen -> windows ----------
+    case 'm': case 'M':
+        setViewLayout((ViewLayout)((viewLayout + 1) % VIEW_LAYOUT_COUNT));
+        break;
+
+    // ---------- 2D toggles ----------
+    case '1': showDoor2D    = !showDoor2D;    break;
+    case '2': showWindows2D = !showWindows2D; break;
+    case '3': showTable2D   = !showTable2D;   break;
+    case '4': showFootprints2D = !showFootprints2D; break;
+
+    // ---------- 3D door toggle ----------
+    case 'o': case 'O':
+        doorOpen = !doorOpen;
+        break;
+
+    // ---------- Fan speed presets ----------
+    // 7 = slow, 8 = normal, 9 = fast, 0 = off
+    case '7': fanSpeedDeg = 1.5f; break;
+    case '8': fanSpeedDeg = 4.0f; break;
+    case '9': fanSpeedDeg = 8.0f; break;
+    case '0': fanSpeedDeg = 0.0f; break;
+
+    // ---------- Camera path + capture ----------
+    case 'r': case 'R':
+        toggleRecording();
+        break;
+    case 'c': case 'C':
+        beginCapture(CAMERA_PATH_FILE, CAPTURE_DIR, 1920, 1080, false);
+        break;
+
+    // ---------- Occupancy simulation ----------
+    case 'p': case 'P':
+        setCrowdEnabled(!crowdEnabled);
+        break;
+    case '+': case '=':
+        setCrowdAgentCount(crowdAgentCount * 2);
+        break;
+    case '-':
+        setCrowdAgentCount(crowdAgentCount / 2);
+        break;
+
+    // ---------- Occlusion culling ----------
+    case 'k': case 'K':
+        occlusionCulling = !occlusionCulling;
+        std::printf("Occlusion culling %s\n", occlusionCulling ? "on" : "off");
+        break;
+
+    // ---------- Plan export (8000 px wide, A3 at ~450 dpi) ----------
+    case 'x': case 'X':
+        exportPlanImage("office_plan.ppm", 8000);
+        break;
+
+    // ---------- Movement keys (set flags) ----------
+    case 'w': case 'W': keyW = true; break;
+    case 's': case 'S': keyS = true; break;
+    case 'a': case 'A': keyA = true; break;
+    case 'd': case 'D': keyD = true; break;
+    case 'q': case 'Q': keyQ = true; break;
+    case 'e': case 'E': keyE = true; break;
+    }
+}
+
+// --------------------------------------------------
+// KEYBOARD (RELEASE)
+// --------------------------------------------------
+void handleKeyUp(unsigned char key)
+{
+    switch (key)
+    {
+    case 'w': case 'W': keyW = false; break;
+    case 's': case 'S': keyS = false; break;
+    case 'a': case 'A': keyA = false; break;
+    case 'd': case 'D': keyD = false; break;
+    case 'q': case 'Q': keyQ = false; break;
+    case 'e': case 'E': keyE = false; break;
+    }
+}
+
+// --------------------------------------------------
+// MOUSE LOOK
+// --------------------------------------------------
+// Only while the cursor is over the perspective view
+void handleMouseLook(int window, int x, int y)
+{
+    int vx, vy;
+    if (viewAt(window, x, y, vx, vy) != VIEW_PERSPECTIVE) { firstMouse = true; return; }
+
+    if (firstMouse)
+    {
+        lastMouseX = x;
+        lastMouseY = y;
+        firstMouse = false;
+        return;
+    }
+
+    float dx = (float)(x - lastMouseX);
+    float dy = (float)(y - lastMouseY);
+    lastMouseX = x;
+    lastMouseY = y;
+
+    const float sensitivity = 0.15f;
+    camYawDeg   += dx * sensitivity;
+    camPitchDeg -= dy * sensitivity;
+
+    // Clamp pitch so we don't flip
+    if (camPitchDeg > 80.0f)  camPitchDeg = 80.0f;
+    if (camPitchDeg < -80.0f) camPitchDeg = -80.0f;
+}
+
+// --------------------------------------------------
+// RESHAPE
+// --------------------------------------------------
+void reshape(int w, int h)
+{
+    w = (w > 1) ? w : 1;
+    h = (h > 1) ? h : 1;
+    int window = glutGetWindow();
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        if (viewWindows[k].id && viewWindows[k].id == window)
+        {
+            viewWindows[k].w = w;
+            viewWindows[k].h = h;
+            return;
+        }
+
+    gWindowWidth  = w;
+    gWindowHeight = h;
+    glViewport(0, 0, gWindowWidth, gWindowHeight);
+}
+
+// --------------------------------------------------
+// UPDATE CAMERA MOVEMENT
+// --------------------------------------------------
+// ticks = elapsed time in 16 ms animation ticks (movement speed is per tick)
+void updateCamera(float ticks)
+{
+    if (!views[VIEW_PERSPECTIVE].window) return;
+
+    const float MOVE_SPEED = 0.10f * ticks;
+    const float DEG2RAD = 3.1415926f / 180.0f;
+
+    float yawRad = camYawDeg * DEG2RAD;
+
+    // Forward & right vectors in XZ plane
+    float forwardX = std::sin(yawRad);
+    float forwardZ = std::cos(yawRad);
+    float rightX   =  forwardZ;
+    float rightZ   = -forwardX;
+
+    if (keyW)
+    {
+        camX += forwardX * MOVE_SPEED;
+        camZ += forwardZ * MOVE_SPEED;
+    }
+    if (keyS)
+    {
+        camX -= forwardX * MOVE_SPEED;
+        camZ -= forwardZ * MOVE_SPEED;
+    }
+    if (keyA)
+    {
+        camX -= rightX * MOVE_SPEED;
+        camZ -= rightZ * MOVE_SPEED;
+    }
+    if (keyD)
+    {
+        camX += rightX * MOVE_SPEED;
+        camZ += rightZ * MOVE_SPEED;
+    }
+    if (keyQ) camY -= MOVE_SPEED;
+    if (keyE) camY += MOVE_SPEED;
+
+    // Clamp to room bounds (stay inside)
+    float margin = 0.6f;
+    if (camX < -ROOM_HALF_WIDTH  + margin) camX = -ROOM_HALF_WIDTH  + margin;
+    if (camX >  ROOM_HALF_WIDTH  - margin) camX =  ROOM_HALF_WIDTH  - margin;
+    if (camZ < -ROOM_HALF_DEPTH  + margin) camZ = -ROOM_HALF_DEPTH  + margin;
+    if (camZ >  ROOM_HALF_DEPTH  - margin) camZ =  ROOM_HALF_DEPTH  - margin;
+    if (camY < 0.7f)             camY = 0.7f;
+    if (camY > ROOM_HEIGHT - 0.3f) camY = ROOM_HEIGHT - 0.3f;
+}
+
+// --------------------------------------------------
+// INPUT QUEUE (timestamped, coalesced per frame)
+// --------------------------------------------------
+// GLUT callbacks only queue events. display() drains the queue right
+// before rendering, so camera changes always land in the next swap, and
+// consecutive mouse moves collapse into one (keeping the oldest time).
+// Latency is measured from each frame's oldest event to its buffer swap.
+// Mouse positions are in the window the event came from. Clicks are queued
+// too, so a press picks against the camera and layout as of the events
+// before it, and press / release pairs apply in order.
+enum InputType { INPUT_KEY_DOWN, INPUT_KEY_UP, INPUT_MOUSE_MOVE, INPUT_MOUSE_DRAG,
+                 INPUT_MOUSE_PRESS, INPUT_MOUSE_RELEASE };
+
+struct InputEvent
+{
+    InputType     type;
+    unsigned char key;
+    int           window;
+    int           x, y;
+    std::chrono::steady_clock::time_point time;
+};
+
+const char*  WINDOW_TITLE            = "Office Designer - Part 1 (2D + Full 3D FPS Preview)";
+const double LATENCY_REPORT_SECONDS  = 2.0;
+const int    INPUT_QUEUE_RESERVE     = 256;
+
+std::vector<InputEvent> inputQueue;
+std::vector<double>     latencySamples;   // ms, since the last report
+std::chrono::steady_clock::time_point lastLatencyReport;
+std::chrono::steady_clock::time_point lastCameraUpdate;
+bool cameraClockStarted = false;
+
+void queueInput(InputType type, unsigned char key, int x, int y)
+{
+    int window = glutGetWindow();
+    bool motion = type == INPUT_MOUSE_MOVE || type == INPUT_MOUSE_DRAG;
+    if (motion && !inputQueue.empty() && inputQueue.back().type == type && inputQueue.back().window == window)
+    {
+        inputQueue.back().x = x;
+        inputQueue.back().y = y;
+        return;
+    }
+
+    InputEvent e = { type, key, window, x, y, std::chrono::steady_clock::now() };
+    inputQueue.push_back(e);
+    postViewRedisplay();
+}
+
+void keyboard(unsigned char key, int x, int y)   { queueInput(INPUT_KEY_DOWN,   key, x, y); }
+void keyboardUp(unsigned char key, int x, int y) { queueInput(INPUT_KEY_UP,     key, x, y); }
+void passiveMouseMotion(int x, int y)            { queueInput(INPUT_MOUSE_MOVE, 0,   x, y); }
+void mouseMotion(int x, int y)                   { queueInput(INPUT_MOUSE_DRAG, 0,   x, y); }
+
+// Picks in the view under the press; in the plan a press on the table,
+// desk or chair starts dragging it (drag events go to updatePlanDrag)
+void handleMousePress(int window, int x, int y)
+{
+    int vx, vy;
+    int kind = viewAt(window, x, y, vx, vy);
+    if (kind < 0) return;
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    selectedObject = pickInView((ViewKind)kind, vx, vy);
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    std::printf("Pick: %s (%.4f ms)\n",
+                selectedObject >= 0 ? pickObjects[selectedObject].name : "nothing", ms);
+
+    if (kind == VIEW_PLAN) beginPlanDrag(selectedObject, vx, vy);
+}
+
+// Plan-view pixel of a drag event; drags outside the plan view clamp to it
+void handleMouseDrag(int window, int x, int y)
+{
+    const View& v = views[VIEW_PLAN];
+    if (dragItem < 0 || v.window != window) return;
+
+    int vx = std::max(0, std::min(v.w - 1, x - v.x));
+    int vy = std::max(0, std::min(v.h - 1, viewWindowHeight(window) - 1 - y - v.y));
+    updatePlanDrag(vx, vy);
+}
+
+// Applies queued input; returns false if there was none
+bool processInput(std::chrono::steady_clock::time_point& oldest)
+{
+    if (inputQueue.empty()) return false;
+
+    oldest = inputQueue.front().time;
+    for (size_t i = 0; i < inputQueue.size(); ++i)
+    {
+        const InputEvent& e = inputQueue[i];
+        switch (e.type)
+        {
+        case INPUT_KEY_DOWN:      handleKeyDown(e.key);                 break;
+        case INPUT_KEY_UP:        handleKeyUp(e.key);                   break;
+        case INPUT_MOUSE_MOVE:    handleMouseLook(e.window, e.x, e.y);  break;
+        case INPUT_MOUSE_DRAG:    handleMouseDrag(e.window, e.x, e.y);  break;
+        case INPUT_MOUSE_PRESS:   handleMousePress(e.window, e.x, e.y); break;
+        case INPUT_MOUSE_RELEASE: endPlanDrag();                        break;
+        }
+    }
+    inputQueue.clear();
+    return true;
+}
+
+void recordInputLatency(std::chrono::steady_clock::time_point eventTime,
+                        std::chrono::steady_clock::time_point swapTime)
+{
+    latencySamples.push_back(std::chrono::duration<double, std::milli>(swapTime - eventTime).count());
+
+    double sinceReport = std::chrono::duration<double>(swapTime - lastLatencyReport).count();
+    if (sinceReport < LATENCY_REPORT_SECONDS) return;
+
+    double sum = 0.0, worst = 0.0;
+    for (size_t i = 0; i < latencySamples.size(); ++i)
+    {
+        sum  += latencySamples[i];
+        worst = std::max(worst, latencySamples[i]);
+    }
+    size_t p95 = (latencySamples.size() * 95) / 100;
+    std::nth_element(latencySamples.begin(), latencySamples.begin() + p95, latencySamples.end());
+
+    char title[192];
+    std::snprintf(title, sizeof(title), "%s  |  input->swap avg %.1f ms, p95 %.1f ms, max %.1f ms  |  %d culled",
+                  WINDOW_TITLE, sum / latencySamples.size(), latencySamples[p95], worst, frameStats.culledObjects);
+    int window = glutGetWindow();
+    if (mainWindow) glutSetWindow(mainWindow);   // the swap may have been a view window's
+    glutSetWindowTitle(title);
+    if (mainWindow) glutSetWindow(window);
+    std::printf("Input latency: %d frames, avg %.2f ms, p95 %.2f ms, max %.2f ms; %d of %zu objects culled\n",
+                (int)latencySamples.size(), sum / latencySamples.size(), latencySamples[p95], worst,
+                frameStats.culledObjects, sceneInstanceCount);
+
+    latencySamples.clear();
+    lastLatencyReport = swapTime;
+}
+
+// --------------------------------------------------
+// MOUSE PICK (CLICK)
+// --------------------------------------------------
+// Left presses and releases are queued like every other event; the pick
+// happens in handleMousePress when the frame drains the queue
+void mouse(int button, int state, int x, int y)
+{
+    if (button != GLUT_LEFT_BUTTON) return;
+    queueInput(state == GLUT_DOWN ? INPUT_MOUSE_PRESS : INPUT_MOUSE_RELEASE, 0, x, y);
+}
+
+// --------------------------------------------------
+// DISPLAY (input -> camera -> render -> swap)
+// --------------------------------------------------
+void display()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point oldestInput;
+    bool hadInput = processInput(oldestInput);
+
+    if (capture.active) return; // frames are produced by captureIdle()
+
+    // Movement scaled by real elapsed time, so a frame that comes early
+    // (input-driven) moves less than one that waited for the timer
+    if (!cameraClockStarted)
+    {
+        lastCameraUpdate   = now;
+        lastLatencyReport  = now;
+        cameraClockStarted = true;
+    }
+    float ticks = std::chrono::duration<float, std::milli>(now - lastCameraUpdate).count() / 16.0f;
+    lastCameraUpdate = now;
+    layoutViews();
+    updateCamera(std::min(ticks, 6.0f));
+
+    // Every window runs this; each draws (or blits) its own views
+    int window = glutGetWindow();
+    int w = gWindowWidth, h = gWindowHeight;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        if (viewWindows[k].id && viewWindows[k].id == window)
+        {
+            w = viewWindows[k].w;
+            h = viewWindows[k].h;
+        }
+    drawWindowViews(window, w, h);
+    glutSwapBuffers();
+
+    if (hadInput)
+        recordInputLatency(oldestInput, std::chrono::steady_clock::now());
+}
+
+// --------------------------------------------------
+// TIMER – FAN + DOOR (+ camera path recording)
+// --------------------------------------------------
+void timer(int)
+{
+    // Capture runs on its own fixed timestep (see captureIdle)
+    if (capture.active)
+    {
+        glutTimerFunc(16, timer, 0);
+        return;
+    }
+
+    stepAnimation();
+
+    // Camera movement is applied per frame in display(), just before drawing
+    if (recordingPath) recordCameraKey();
+
+    postViewRedisplay();   // views whose inputs didn't change just blit
+    glutTimerFunc(16, timer, 0); // ~60 FPS
+}
+
+// --------------------------------------------------
+// VIEW WINDOWS (LAYOUT_WINDOWS)
+// --------------------------------------------------
+// The perspective and elevation windows are created once, sharing the
+// main window's context (so the scene buffers and view framebuffers are
+// the same objects), and are hidden rather than destroyed when the
+// layout changes.
+const int VIEW_WINDOW_WIDTH  = 640;
+const int VIEW_WINDOW_HEIGHT = 480;
+
+void viewWindowClosed()
+{
+    int window = glutGetWindow();
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        if (viewWindows[k].id == window) viewWindows[k].id = 0;
+}
+
+void mainWindowClosed()
+{
+    std::exit(0);
+}
+
+void registerWindowCallbacks()
+{
+    glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
+    glutKeyboardFunc(keyboard);
+    glutKeyboardUpFunc(keyboardUp);
+    glutPassiveMotionFunc(passiveMouseMotion);
+    glutMotionFunc(mouseMotion);
+    glutMouseFunc(mouse);
+}
+
+void openViewWindow(ViewKind kind)
+{
+    glutSetWindow(mainWindow);
+    glutSetOption(GLUT_RENDERING_CONTEXT, GLUT_USE_CURRENT_CONTEXT);
+    glutInitWindowSize(VIEW_WINDOW_WIDTH, VIEW_WINDOW_HEIGHT);
+
+    ViewWindow& vw = viewWindows[kind];
+    vw.id = glutCreateWindow(VIEW_NAMES[kind]);
+    vw.w  = VIEW_WINDOW_WIDTH;
+    vw.h  = VIEW_WINDOW_HEIGHT;
+    registerWindowCallbacks();
+    glutCloseFunc(viewWindowClosed);
+
+    glutSetOption(GLUT_RENDERING_CONTEXT, GLUT_CREATE_NEW_CONTEXT);
+    glutSetWindow(mainWindow);
+}
+
+void setViewLayout(ViewLayout layout)
+{
+    viewLayout = layout;
+    for (int k = VIEW_PERSPECTIVE; k < VIEW_KIND_COUNT; ++k)
+    {
+        if (layout == LAYOUT_WINDOWS)
+        {
+            if (!viewWindows[k].id) openViewWindow((ViewKind)k);
+            glutSetWindow(viewWindows[k].id);
+            glutShowWindow();
+        }
+        else if (viewWindows[k].id)
+        {
+            glutSetWindow(viewWindows[k].id);
+            glutHideWindow();
+        }
+    }
+    glutSetWindow(mainWindow);
+    firstMouse = true;
+
+    // The single view draws straight to the window; drop the cached images
+    if (layout == LAYOUT_SINGLE)
+        for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+            destroyOffscreenTarget(views[k].fbo, views[k].colorRb, views[k].depthRb);
+
+    layoutViews();
+    postViewRedisplay();
+    std::printf("Views: %s\n", VIEW_LAYOUT_NAMES[layout]);
+}
+
+// --------------------------------------------------
+// INIT
+// --------------------------------------------------
+void initGL()
+{
+    glClearColor(CLEAR_R, CLEAR_G, CLEAR_B, 1.0f);
+    loadGLExtensions();
+    uploadSceneBuffers();
+}
+
+// --------------------------------------------------
+// SELF TEST (golden images + frame budgets)
+// --------------------------------------------------
+// Built only with -DOFFICE_SELFTEST. --selftest renders fixed 2D plan
+// states and 3D camera poses, compares them with golden/*.ppm and checks
+// frame time, draw calls and heap allocations against golden/budgets.txt.
+// The plan goldens use the CPU rasterizer and need no GL. The GL cases
+// (on-screen plan frame, 3D poses) get a headless EGL context on Linux
+// (Mesa's surfaceless platform, so llvmpipe renders without a display) or
+// a hidden GLUT window otherwise. No context is a failure; --skip-gl runs
+// only the CPU cases. --update-golden re-records everything, or only the
+// cases named after it.
+// Budgets are kept in the units of the machine that recorded them: a fixed
+// CPU workload (the plan raster) is timed at startup and every time limit
+// is scaled by its ratio to the recorded "reference" time. The 3D goldens
+// and GL timings only compare on the GL renderer named by "renderer" (Mesa
+// llvmpipe); on any other they are skipped, draw calls and allocations are
+// still checked.
+#ifdef OFFICE_SELFTEST
+const char*  GOLDEN_DIR                 = "golden";
+const int    GOLDEN_CHANNEL_TOLERANCE   = 16;
+const double GOLDEN_MAX_BAD_FRACTION_2D = 0.0;    // CPU raster is exact
+const double GOLDEN_MAX_BAD_FRACTION_3D = 0.005;
+const int    SELFTEST_3D_WIDTH          = 320;
+const int    SELFTEST_3D_HEIGHT         = 240;
+const int    SELFTEST_TIMING_RUNS       = 21;
+
+// -1 in any field means "not checked" for that case
+struct FrameBudget
+{
+    double maxMs;
+    int    maxDrawCalls;
+    long   maxAllocs;
+};
+
+struct SelfTestState
+{
+    bool updateGolden;
+    bool skipGL;                          // --skip-gl: CPU cases only
+    std::vector<std::string> recordOnly;  // cases named after --update-golden; empty = all
+    int  passed, failed, skipped;
+    std::vector<std::pair<std::string, FrameBudget> > budgets;
+
+    std::string machine;                  // budgets.txt: where the budgets were recorded
+    double      referenceMs;              // budgets.txt: reference workload there
+    double      timeScale;                // this machine's reference / referenceMs
+    std::string renderer;                 // budgets.txt: GL renderer of the 3D goldens
+    std::string glRenderer;               // this context's GL renderer
+    bool        glComparable;             // glRenderer is renderer
+};
+
+SelfTestState selfTest = {};
+
+std::string goldenPath(const std::string& file)
+{
+    return std::string(GOLDEN_DIR) + "/" + file;
+}
+
+bool recordingGolden(const std::string& name)
+{
+    return selfTest.updateGolden &&
+           (selfTest.recordOnly.empty() ||
+            std::find(selfTest.recordOnly.begin(), selfTest.recordOnly.end(), name) != selfTest.recordOnly.end());
+}
+
+void selfTestResult(bool ok, const std::string& name, const std::string& detail)
+{
+    std::printf("[%s] %-22s %s\n", ok ? "PASS" : "FAIL", name.c_str(), detail.c_str());
+    if (ok) ++selfTest.passed;
+    else    ++selfTest.failed;
+}
+
+// "machine", "reference" and "renderer" lines describe the recording
+// setup; every other line is a case budget
+void loadBudgets()
+{
+    selfTest.budgets.clear();
+    FILE* f = std::fopen(goldenPath("budgets.txt").c_str(), "r");
+    if (!f) return;
+
+    char line[256], name[128];
+    while (std::fgets(line, sizeof(line), f))
+    {
+        FrameBudget b;
+        int rest = 0;
+        if (line[0] == '#' || std::sscanf(line, "%127s %n", name, &rest) != 1) continue;
+
+        std::string value(line + rest);
+        while (!value.empty() && (value.back() == '\n' || value.back() == '\r')) value.pop_back();
+        if (std::strcmp(name, "machine") == 0)        selfTest.machine     = value;
+        else if (std::strcmp(name, "reference") == 0) selfTest.referenceMs = std::atof(value.c_str());
+        else if (std::strcmp(name, "renderer") == 0)  selfTest.renderer    = value;
+        else if (std::sscanf(line, "%127s %lf %d %ld", name, &b.maxMs, &b.maxDrawCalls, &b.maxAllocs) == 4)
+            selfTest.budgets.push_back(std::make_pair(std::string(name), b));
+    }
+    std::fclose(f);
+}
+
+void saveBudgets()
+{
+    FILE* f = std::fopen(goldenPath("budgets.txt").c_str(), "w");
+    if (!f) return;
+
+    std::fprintf(f, "# case maxMs maxDrawCalls maxAllocs   (-1 = unchecked)\n");
+    std::fprintf(f, "# maxMs is in the recording machine's time; limits scale by reference\n");
+    std::fprintf(f, "machine %s\n", selfTest.machine.c_str());
+    std::fprintf(f, "reference %.4f\n", selfTest.referenceMs);
+    if (!selfTest.renderer.empty()) std::fprintf(f, "renderer %s\n", selfTest.renderer.c_str());
+    for (size_t i = 0; i < selfTest.budgets.size(); ++i)
+    {
+        const FrameBudget& b = selfTest.budgets[i].second;
+        std::fprintf(f, "%s %.4f %d %ld\n", selfTest.budgets[i].first.c_str(),
+                     b.maxMs, b.maxDrawCalls, b.maxAllocs);
+    }
+    std::fclose(f);
+}
+
+FrameBudget* findBudget(const std::string& name)
+{
+    for (size_t i = 0; i < selfTest.budgets.size(); ++i)
+        if (selfTest.budgets[i].first == name) return &selfTest.budgets[i].second;
+    return nullptr;
+}
+
+// Recording keeps draw calls / allocations exact and gives timing headroom.
+// timed = false leaves the time unchecked (GL cases on another renderer).
+void checkBudget(const std::string& name, double ms, int drawCalls, long allocs, bool timed = true)
+{
+    char detail[160];
+    std::snprintf(detail, sizeof(detail), "%.4f ms, %d draw calls, %ld allocs", ms,
+                  drawCalls, allocs);
+
+    FrameBudget* b = findBudget(name);
+    if (recordingGolden(name))
+    {
+        FrameBudget rec = { (ms * 2.0 + 0.5) / selfTest.timeScale, drawCalls, allocs };
+        if (b) *b = rec;
+        else   selfTest.budgets.push_back(std::make_pair(name, rec));
+        selfTestResult(true, name + " budget", std::string("recorded: ") + detail);
+        return;
+    }
+    if (!b)
+    {
+        selfTestResult(false, name + " budget", "no budget recorded (run --selftest --update-golden)");
+        return;
+    }
+
+    double maxMs = (b->maxMs < 0 || !timed) ? -1.0 : b->maxMs * selfTest.timeScale;
+    bool ok = (maxMs           < 0 || ms        <= maxMs) &&
+              (b->maxDrawCalls < 0 || drawCalls <= b->maxDrawCalls) &&
+              (b->maxAllocs    < 0 || allocs    <= b->maxAllocs);
+    char limits[128];
+    std::snprintf(limits, sizeof(limits), " (budget %.4f / %d / %ld)", maxMs, b->maxDrawCalls, b->maxAllocs);
+    selfTestResult(ok, name + " budget", std::string(detail) + limits);
+}
+
+bool readPPM(const std::string& path, int& w, int& h, std::vector<unsigned char>& rgb)
+{
+    FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    int maxVal = 0;
+    bool ok = std::fscanf(f, "P6 %d %d %d", &w, &h, &maxVal) == 3 && maxVal == 255 &&
+              std::fgetc(f) != EOF;
+    if (ok)
+    {
+        rgb.resize((size_t)w * h * 3);
+        ok = std::fread(&rgb[0], 1, rgb.size(), f) == rgb.size();
+    }
+    std::fclose(f);
+    return ok;
+}
+
+// rgba is bottom-up (GL / plan buffer order), goldens are PPM top-down
+void checkImage(const std::string& name, int w, int h, const std::vector<unsigned char>& rgba,
+                double maxBadFraction)
+{
+    std::string path = goldenPath(name + ".ppm");
+    if (recordingGolden(name))
+    {
+        writeFramePPM(path, w, h, rgba);
+        selfTestResult(true, name, "golden recorded");
+        return;
+    }
+
+    int gw = 0, gh = 0;
+    std::vector<unsigned char> golden;
+    if (!readPPM(path, gw, gh, golden))
+    {
+        selfTestResult(false, name, "missing " + path + " (run --selftest --update-golden)");
+        return;
+    }
+    if (gw != w || gh != h)
+    {
+        selfTestResult(false, name, "golden size differs");
+        return;
+    }
+
+    long bad = 0;
+    int  worst = 0;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+        {
+            const unsigned char* a = &rgba[((size_t)(h - 1 - y) * w + x) * 4];
+            const unsigned char* g = &golden[((size_t)y * w + x) * 3];
+            int d = std::max(std::abs(a[0] - g[0]), std::max(std::abs(a[1] - g[1]), std::abs(a[2] - g[2])));
+            worst = std::max(worst, d);
+            if (d > GOLDEN_CHANNEL_TOLERANCE) ++bad;
+        }
+
+    double fraction = bad / (double)((long)w * h);
+    char detail[128];
+    std::snprintf(detail, sizeof(detail), "%ld pixels off (%.3f%%), max channel diff %d",
+                  bad, fraction * 100.0, worst);
+    selfTestResult(fraction <= maxBadFraction, name, detail);
+}
+
+// CPU model and thread count, recorded next to the budgets
+std::string machineDescription()
+{
+    std::string cpu = "unknown CPU";
+#ifdef _WIN32
+    if (const char* id = std::getenv("PROCESSOR_IDENTIFIER")) cpu = id;
+#else
+    if (FILE* f = std::fopen("/proc/cpuinfo", "r"))
+    {
+        char line[256];
+        while (std::fgets(line, sizeof(line), f))
+            if (std::strncmp(line, "model name", 10) == 0 && std::strchr(line, ':'))
+            {
+                cpu = std::strchr(line, ':') + 2;
+                while (!cpu.empty() && (cpu.back() == '\n' || cpu.back() == '\r')) cpu.pop_back();
+                break;
+            }
+        std::fclose(f);
+    }
+#endif
+    char threads[32];
+    std::snprintf(threads, sizeof(threads), " x%u", std::thread::hardware_concurrency());
+    return cpu + threads;
+}
+
+double medianMs(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+void resetPlanState()
+{
+    showDoor2D = showWindows2D = showTable2D = true;
+    showFootprints2D = false;
+    selectedObject = -1;
+}
+
+// Timing budgets are scaled by this: the default plan rasterized on the CPU
+double measureReferenceMs()
+{
+    resetPlanState();
+    buildOfficePlan2D();
+    std::vector<uint32_t> pixels((size_t)PLAN_CACHE_WIDTH * PLAN_CACHE_HEIGHT);
+    PlanTile t = { &pixels[0], PLAN_CACHE_WIDTH, 0, 0, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT };
+
+    std::vector<double> times;
+    for (int i = 0; i < SELFTEST_TIMING_RUNS; ++i)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < 10; ++r) rasterPlanTile(t, planRasterScratch, planPrims, planPolyVerts);
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return medianMs(times);
+}
 
-    // ---------- 3D door toggle ----------
-    case 'o': case 'O':
-        doorOpen = !doorOpen;
-        break;
+// 2D plan: golden images of a few toggle states at export framing
+void runPlanSelfTests()
+{
+    struct PlanCase { const char* name; bool fills, door, table; const char* select; };
+    const PlanCase cases[] = {
+        { "plan_default",  false, true,  true,  nullptr },
+        { "plan_outlines", false, false, true,  nullptr },
+        { "plan_selected", true,  true,  false, "Desk"  },
+    };
 
-    // ---------- Fan speed presets ----------
-    // 7 = slow, 8 = normal, 9 = fast
-    case '7': fanSpeedDeg = 1.5f; break;
-    case '8': fanSpeedDeg = 4.0f; break;
-    case '9': fanSpeedDeg = 8.0f; break;
+    long rerasterAllocs = 0;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+    {
+        resetPlanState();
+        showFootprints2D = cases[c].fills;
+        showDoor2D       = cases[c].door;
+        showTable2D      = cases[c].table;
+        for (size_t i = 0; cases[c].select && i < pickObjects.size(); ++i)
+            if (std::strcmp(pickObjects[i].name, cases[c].select) == 0) selectedObject = (int)i;
 
-    // ---------- Movement keys (set flags) ----------
-    case 'w': case 'W': keyW = true; break;
-    case 's': case 'S': keyS = true; break;
-    case 'a': case 'A': keyA = true; break;
-    case 'd': case 'D': keyD = true; break;
-    case 'q': case 'Q': keyQ = true; break;
-    case 'e': case 'E': keyE = true; break;
+        buildOfficePlan2D();
+        addSelectionHighlight2D();
+        std::vector<PlanPrimitive> prims = planPrims;
+        std::vector<int> verts = planPolyVerts;
+
+        const int w = 300;
+        double scale = w / (double)(PLAN_EXTENT_MAX_X - PLAN_EXTENT_MIN_X);
+        int h = (int)std::lround((PLAN_EXTENT_MAX_Y - PLAN_EXTENT_MIN_Y) * scale);
+        scalePlanPrimitives(prims, verts, scale);
+
+        std::vector<uint32_t> pixels((size_t)w * h);
+        PlanTile t = { &pixels[0], w, 0, 0, w, h };
+        rasterPlanTile(t, planRasterScratch, prims, verts);
+
+        // Once the scratch has grown, rasterizing again allocates nothing
+        long allocsBefore = heapAllocCount.load();
+        rasterPlanTile(t, planRasterScratch, prims, verts);
+        rerasterAllocs += heapAllocCount.load() - allocsBefore;
+
+        std::vector<unsigned char> rgba((size_t)w * h * 4);
+        std::memcpy(&rgba[0], &pixels[0], rgba.size());
+        checkImage(cases[c].name, w, h, rgba, GOLDEN_MAX_BAD_FRACTION_2D);
     }
 
-    glutPostRedisplay();
+    char detail[64];
+    std::snprintf(detail, sizeof(detail), "%ld allocations re-rasterizing", rerasterAllocs);
+    selfTestResult(rerasterAllocs == 0, "raster_scratch", detail);
 }
 
-// --------------------------------------------------
-// KEYBOARD (RELEASE)
-// --------------------------------------------------
-void keyboardUp(unsigned char key, int, int)
+// The on-screen plan frame at the default window size, through
+// drawPlanView / drawOfficePlan2D into an offscreen target: time of a full
+// re-raster (the frame after an edit), draw calls and allocations of a
+// steady-state frame where the cached buffer is reused
+void runPlanFrameSelfTest()
 {
-    switch (key)
+    const int w = 1000, h = 900;
+    GLuint fbo, colorRb, depthRb;
+    if (!createOffscreenTarget(w, h, fbo, colorRb, depthRb))
     {
-    case 'w': case 'W': keyW = false; break;
-    case 's': case 'S': keyS = false; break;
-    case 'a': case 'A': keyA = false; break;
-    case 'd': case 'D': keyD = false; break;
-    case 'q': case 'Q': keyQ = false; break;
-    case 'e': case 'E': keyE = false; break;
+        selfTestResult(false, "plan_frame budget", "framebuffer objects unavailable");
+        return;
+    }
+    pglBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, w, h);
+
+    // Time the raster, not the cached spans the startup frame decodes
+    const PlanSpan* savedSpans = planCacheSpans;
+    planCacheSpans = nullptr;
+
+    resetPlanState();
+    PlanFraming framing = planFraming(w, h, true);
+    std::vector<double> times;
+    for (int i = 0; i < SELFTEST_TIMING_RUNS; ++i)
+    {
+        planBufferW = 0; // force a full re-raster
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        drawPlanView(w, h, framing);
+        glFinish();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
     }
+
+    frameStats.drawCalls = 0;
+    long allocsBefore = heapAllocCount.load();
+    drawPlanView(w, h, framing);
+    long steadyAllocs = heapAllocCount.load() - allocsBefore;
+    int  drawCalls = frameStats.drawCalls;
+
+    checkBudget("plan_frame", medianMs(times), drawCalls, steadyAllocs, selfTest.glComparable);
+
+    planCacheSpans = savedSpans;
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    destroyOffscreenTarget(fbo, colorRb, depthRb);
 }
 
-// --------------------------------------------------
-// MOUSE LOOK
-// --------------------------------------------------
-void passiveMouseMotion(int x, int y)
+// Click at window pixel (mouseX, mouseY) of window, through the view under it
+int pickInWindow(int window, int mouseX, int mouseY)
+{
+    int x, y;
+    int kind = viewAt(window, mouseX, mouseY, x, y);
+    return kind < 0 ? -1 : pickInView((ViewKind)kind, x, y);
+}
+
+// Picking: fixed clicks on the single view must hit the expected objects,
+// within budget
+void runPickingSelfTests()
 {
-    if (!is3DMode) { firstMouse = true; return; }
+    struct PickCase { bool in3D; float camX, camY, camZ, yaw, pitch; int mx, my; const char* expect; };
+    const PickCase cases[] = {
+        { true,  0.0f, 1.7f, 7.0f,  180.0f, -10.0f, 500, 450, "Meeting table" },
+        { true,  0.0f, 1.6f, 7.0f,  180.0f,   0.0f, 500, 430, "Whiteboard"    },
+        { true,  0.0f, 1.6f, 5.0f,    0.0f,   0.0f, 500, 600, "Door"          },
+        { false, 0.0f, 0.0f, 0.0f,    0.0f,   0.0f, 300, 419, "Desk"          },
+        { false, 0.0f, 0.0f, 0.0f,    0.0f,   0.0f, 465, 424, "Chair"         },  // inside the table disc
+        { false, 0.0f, 0.0f, 0.0f,    0.0f,   0.0f, 500, 479, "Meeting table" },
+        { false, 0.0f, 0.0f, 0.0f,    0.0f,   0.0f,  50,  50, nullptr         },
+    };
 
-    if (firstMouse)
+    ViewLayout savedLayout = viewLayout;
+    viewLayout = LAYOUT_SINGLE;
+    mainWindow = 1;   // no GLUT here; any id the views are placed in
+    gWindowWidth = 1000; gWindowHeight = 900;
+    doorAngleDeg = 0.0f;
+    bool allOk = true;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
     {
-        lastMouseX = x;
-        lastMouseY = y;
-        firstMouse = false;
-        return;
+        const PickCase& p = cases[c];
+        is3DMode = p.in3D;
+        layoutViews();
+        camX = p.camX; camY = p.camY; camZ = p.camZ;
+        camYawDeg = p.yaw; camPitchDeg = p.pitch;
+        int hit = pickInWindow(mainWindow, p.mx, p.my);
+        const char* got = (hit >= 0) ? pickObjects[hit].name : nullptr;
+        bool ok = (got && p.expect) ? std::strcmp(got, p.expect) == 0 : got == p.expect;
+        if (!ok)
+        {
+            std::printf("       case %d: expected %s, got %s\n", (int)c,
+                        p.expect ? p.expect : "nothing", got ? got : "nothing");
+            allOk = false;
+        }
     }
+    selfTestResult(allOk, "picking_hits", "fixed rays / plan points");
 
-    float dx = (float)(x - lastMouseX);
-    float dy = (float)(y - lastMouseY);
-    lastMouseX = x;
-    lastMouseY = y;
+    // Sweep the screen from the entrance pose; report the mean pick cost
+    is3DMode = true;
+    layoutViews();
+    camX = 0.0f; camY = 1.7f; camZ = ROOM_HALF_DEPTH - 1.0f;
+    camYawDeg = 180.0f; camPitchDeg = -10.0f;
+    const int picks = 20000;
+    long allocsBefore = heapAllocCount.load();
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    int sink = 0;
+    for (int i = 0; i < picks; ++i)
+        sink += pickInWindow(mainWindow, (i * 37) % gWindowWidth, (i * 53) % gWindowHeight);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() / picks;
+    long allocs = heapAllocCount.load() - allocsBefore;
+    (void)sink;
 
-    const float sensitivity = 0.15f;
-    camYawDeg   += dx * sensitivity;
-    camPitchDeg -= dy * sensitivity;
+    char detail[64];
+    std::snprintf(detail, sizeof(detail), "%.4f ms per pick (limit 1 ms)", ms);
+    selfTestResult(ms < 1.0, "picking_latency", detail);
+    checkBudget("picking", ms, -1, allocs);
+    is3DMode = false;
+    viewLayout = savedLayout;
+    mainWindow = 0;
+    layoutViews();
+}
 
-    // Clamp pitch so we don't flip
-    if (camPitchDeg > 80.0f)  camPitchDeg = 80.0f;
-    if (camPitchDeg < -80.0f) camPitchDeg = -80.0f;
+// Scene cache: a written cache maps back to exactly the built scene, a
+// different layout key is rejected, and a cold start on a hit (key plus
+// map) stays cheap.
+void runSceneCacheSelfTests()
+{
+    resetPlanState();
+    doorAngleDeg = 0.0f;
+    buildScene();
+    uint64_t layoutHash = sceneLayoutHash();
 
-    glutPostRedisplay();
+    std::error_code ec;
+    std::string path = (std::filesystem::temp_directory_path(ec) / "officedesigner_selftest_cache.bin").string();
+    Bvh bvh3D = pickBvh3D, bvh2D = pickBvh2D;
+    std::vector<PickObject> picks = pickObjects;
+
+    bool ok = writeSceneCache(path.c_str(), layoutHash) &&
+              !mapSceneCache(path.c_str(), layoutHash ^ 1);
+
+    long allocsBefore = heapAllocCount.load();
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    bool mapped = mapSceneCache(path.c_str(), sceneLayoutHash());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    long allocs = heapAllocCount.load() - allocsBefore;
+
+    ok = ok && mapped && pickObjects.size() == picks.size() && pickDoorIndex >= 0;
+    for (size_t i = 0; i < picks.size() && ok; ++i)
+        ok = std::strcmp(pickObjects[i].name, picks[i].name) == 0 &&
+             pickObjects[i].cx == picks[i].cx && pickObjects[i].cz == picks[i].cz &&
+             pickObjects[i].hx == picks[i].hx && pickObjects[i].px == picks[i].px &&
+             pickObjects[i].phx == picks[i].phx;
+    ok = ok &&
+         sceneVertexCount == sceneVertexStore.size() &&
+         std::memcmp(sceneVertices, &sceneVertexStore[0], sceneVertexCount * sizeof(SceneVertex)) == 0 &&
+         sceneIndexCount == sceneIndexStore.size() &&
+         std::memcmp(sceneIndices, &sceneIndexStore[0], sceneIndexCount * sizeof(uint32_t)) == 0 &&
+         sceneInstanceCount == sceneInstanceStore.size() &&
+         std::memcmp(sceneInstances, &sceneInstanceStore[0], sceneInstanceCount * sizeof(SceneInstance)) == 0 &&
+         pickBvh3D.indices == bvh3D.indices && pickBvh2D.indices == bvh2D.indices &&
+         pickBvh3D.nodes.size() == bvh3D.nodes.size() && pickBvh2D.nodes.size() == bvh2D.nodes.size() &&
+         std::memcmp(pickBvh3D.nodes.data(), bvh3D.nodes.data(), bvh3D.nodes.size() * sizeof(BvhNode)) == 0 &&
+         std::memcmp(pickBvh2D.nodes.data(), bvh2D.nodes.data(), bvh2D.nodes.size() * sizeof(BvhNode)) == 0 &&
+         planCacheSpanCount == planSpanStore.size() &&
+         std::memcmp(planCacheSpans, &planSpanStore[0], planCacheSpanCount * sizeof(PlanSpan)) == 0;
+
+    // The cached spans must reproduce the rasterized startup plan
+    std::vector<uint32_t> raster((size_t)PLAN_CACHE_WIDTH * PLAN_CACHE_HEIGHT), spans(raster.size());
+    PlanTile rt = { &raster[0], PLAN_CACHE_WIDTH, 0, 0, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT };
+    PlanTile st = { &spans[0],  PLAN_CACHE_WIDTH, 0, 0, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT };
+    rasterPlanTile(rt, planRasterScratch, planPrims, planPolyVerts);
+    decodePlanSpans(st, planCacheSpans, planCacheSpanCount);
+    ok = ok && raster == spans;
+
+    char detail[128];
+    std::snprintf(detail, sizeof(detail), "%zu vertices, %zu objects, %zu plan spans round-trip",
+                  sceneVertexCount, sceneInstanceCount, planCacheSpanCount);
+    selfTestResult(ok, "scene_cache", detail);
+    checkBudget("scene_cache_load", ms, -1, allocs);
+
+    // Back to the built scene so the temp file can be rewritten
+    useSceneStore();
+    planCacheSpans = planSpanStore.empty() ? nullptr : &planSpanStore[0];
+    unmapFile(sceneCacheMap);
+
+    // Corrupt contents map (only the header and section bounds are checked
+    // up front) but are never followed: a span running past the tile edge
+    // is dropped on decode, an out-of-range index drops its instance
+    bool written = false;
+    if (FILE* f = std::fopen(path.c_str(), "r+b"))
+    {
+        SceneCacheHeader h;
+        PlanSpan bad = planSpanStore[0];
+        bad.x      = (uint16_t)(PLAN_CACHE_WIDTH - 1);
+        bad.length = 2;
+        uint32_t badIndex = (uint32_t)sceneVertexStore.size();
+        long firstIndex = (long)(sceneInstanceStore[0].firstIndex * sizeof(uint32_t));
+        written = std::fread(&h, sizeof(h), 1, f) == 1 &&
+                  std::fseek(f, (long)h.offset[CACHE_PLAN_SPANS], SEEK_SET) == 0 &&
+                  std::fwrite(&bad, sizeof(bad), 1, f) == 1 &&
+                  std::fseek(f, (long)h.offset[CACHE_INDICES] + firstIndex, SEEK_SET) == 0 &&
+                  std::fwrite(&badIndex, sizeof(badIndex), 1, f) == 1;
+        std::fclose(f);
+    }
+    bool contained = written && mapSceneCache(path.c_str(), layoutHash);
+    if (contained)
+    {
+        // One row of slack past the tile must stay untouched
+        std::vector<uint32_t> decoded((size_t)PLAN_CACHE_WIDTH * (PLAN_CACHE_HEIGHT + 1), 0u);
+        PlanTile dt = { &decoded[0], PLAN_CACHE_WIDTH, 0, 0, PLAN_CACHE_WIDTH, PLAN_CACHE_HEIGHT };
+        decodePlanSpans(dt, planCacheSpans, planCacheSpanCount);
+        for (size_t i = (size_t)PLAN_CACHE_WIDTH * PLAN_CACHE_HEIGHT; i < decoded.size(); ++i)
+            contained = contained && decoded[i] == 0u;
+        contained = contained && !sceneInstanceValid(0) && sceneInstanceValid(1);
+    }
+    useSceneStore();
+    planCacheSpans = planSpanStore.empty() ? nullptr : &planSpanStore[0];
+    unmapFile(sceneCacheMap);
+    selfTestResult(contained, "scene_cache_corrupt", "bad span and index skipped on use");
+    std::filesystem::remove(path, ec);
 }
 
-// --------------------------------------------------
-// RESHAPE
-// --------------------------------------------------
-void reshape(int w, int h)
+// Occupancy: every reachable cell's flow descends to a goal, agents stay
+// on the floor, and a tick of CROWD_SELFTEST_AGENTS stays within budget
+const int CROWD_SELFTEST_AGENTS = 2000;
+
+void runCrowdSelfTests()
 {
-    gWindowWidth  = (w > 1) ? w : 1;
-    gWindowHeight = (h > 1) ? h : 1;
-    glViewport(0, 0, gWindowWidth, gWindowHeight);
+    crowdAgentCount = CROWD_SELFTEST_AGENTS;
+    crowdAgents.clear();
+    navGridValid = false;
+    setCrowdEnabled(true);
+
+    bool flowOk = true;
+    for (int d = 0; d < CROWD_DEST_COUNT && flowOk; ++d)
+    {
+        const FlowField& f = crowdFields[d];
+        for (int c = 0; c < NAV_W * NAV_H && flowOk; ++c)
+        {
+            if (f.cost[c] == 0.0f || f.cost[c] >= INF_COST) continue;
+            int n = (c / NAV_W + (int)std::lround(f.dirZ[c])) * NAV_W + c % NAV_W + (int)std::lround(f.dirX[c]);
+            flowOk = !navBlocked[n] && f.cost[n] < f.cost[c];
+        }
+    }
+
+    // The first tick starts the workers and sizes the buffers; the rest
+    // must not allocate
+    stepCrowd();
+    std::vector<double> times;
+    times.reserve(120);
+    long allocsBefore = heapAllocCount.load();
+    for (int i = 0; i < 120; ++i)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        stepCrowd();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    long allocs = heapAllocCount.load() - allocsBefore;
+
+    int outside = 0;
+    for (size_t i = 0; i < crowdAgents.size(); ++i)
+        if (std::fabs(crowdAgents[i].x) > ROOM_HALF_WIDTH || std::fabs(crowdAgents[i].z) > ROOM_HALF_DEPTH)
+            ++outside;
+
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "%d destinations, %d agents, %d outside the room",
+                  CROWD_DEST_COUNT, (int)crowdAgents.size(), outside);
+    selfTestResult(flowOk && outside == 0, "crowd_flow", detail);
+    checkBudget("crowd_step", medianMs(times), -1, allocs);
+
+    // Drop the desk 2 m forward onto a walking agent: it must leave the
+    // footprint and walk on instead of waiting there forever
+    const int dropMoveY = -75;   // plan px; world +2 m in z
+    float dropX = 0.0f, dropZ = 0.0f;
+    for (size_t i = 0; i < pickObjects.size(); ++i)
+        if (pickObjects[i].source == OBJ_DESK)
+        {
+            dropX = pickObjects[i].cx;
+            dropZ = pickObjects[i].cz - dropMoveY / PLAN_PX_PER_M_Z;
+        }
+    int dropCell = navCellZ(dropZ) * NAV_W + navCellX(dropX);
+    Agent& agent = crowdAgents[0];
+    agent.x = navCenterX(dropCell % NAV_W);
+    agent.z = navCenterZ(dropCell / NAV_W);
+    agent.state = AGENT_WALKING;
+    agent.dest  = 0;
+    bool wasFree = !navBlocked[dropCell];
+
+    planMoveY[PLAN_DESK] = dropMoveY;
+    applyFurnitureMoves();
+    rebuildNavigation();
+    bool covered = navBlocked[dropCell] != 0;
+    float startX = agent.x, startZ = agent.z;
+    for (int i = 0; i < 30; ++i) stepCrowd();
+    int cell = navCellZ(agent.z) * NAV_W + navCellX(agent.x);
+    bool freed = wasFree && covered && !navBlocked[cell] && (agent.x != startX || agent.z != startZ);
+
+    planMoveY[PLAN_DESK] = 0;
+    applyFurnitureMoves();
+    rebuildNavigation();
+    selfTestResult(freed, "crowd_stranded", "agent under a dropped desk walks out");
+    setCrowdEnabled(false);
 }
 
-// --------------------------------------------------
-// UPDATE CAMERA MOVEMENT
-// --------------------------------------------------
-void updateCamera()
+// Occlusion: from behind the back wall the free-standing furniture is
+// hidden; from the entrance the main pieces survive. The cull is timed at the entrance.
+void runOcclusionSelfTests()
 {
-    if (!is3DMode) return;
+    doorAngleDeg = 0.0f;
+    fanAngleDeg  = 30.0f;
+    double aspect = (double)SELFTEST_3D_WIDTH / SELFTEST_3D_HEIGHT;
+    float viewProj[16];
 
-    const float MOVE_SPEED = 0.10f;
-    const float DEG2RAD = 3.1415926f / 180.0f;
+    camX = 0.0f; camY = 1.7f; camZ = -ROOM_HALF_DEPTH - 4.0f;
+    camYawDeg = 0.0f; camPitchDeg = 0.0f;
+    cameraViewProjection(aspect, viewProj);
+    int culledOutside = cullSceneInstances(viewProj, fanAngleDeg);
+    const int hidden[] = { OBJ_TABLE, OBJ_DESK, OBJ_CHAIR, OBJ_PERSON,
+                           OBJ_MONITOR, OBJ_KEYBOARD, OBJ_LAMP, OBJ_PLANT };
+    bool ok = sceneVisible[OBJ_ROOM] != 0;
+    for (size_t i = 0; i < sizeof(hidden) / sizeof(hidden[0]); ++i)
+        ok = ok && !sceneVisible[hidden[i]];
 
-    float yawRad = camYawDeg * DEG2RAD;
+    camX = 0.0f; camY = 1.7f; camZ = ROOM_HALF_DEPTH - 1.0f;
+    camYawDeg = 180.0f; camPitchDeg = -10.0f;
+    cameraViewProjection(aspect, viewProj);
+    int culledEntrance = cullSceneInstances(viewProj, fanAngleDeg);
+    const int shown[] = { OBJ_TABLE, OBJ_DESK, OBJ_CABINET, OBJ_WHITEBOARD };
+    for (size_t i = 0; i < sizeof(shown) / sizeof(shown[0]); ++i)
+        ok = ok && sceneVisible[shown[i]];
 
-    // Forward & right vectors in XZ plane
-    float forwardX = std::sin(yawRad);
-    float forwardZ = std::cos(yawRad);
-    float rightX   =  forwardZ;
-    float rightZ   = -forwardX;
+    std::vector<double> times;
+    times.reserve(SELFTEST_TIMING_RUNS);
+    long allocsBefore = heapAllocCount.load();
+    for (int i = 0; i < SELFTEST_TIMING_RUNS; ++i)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        cullSceneInstances(viewProj, fanAngleDeg);
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+    }
+    long allocs = heapAllocCount.load() - allocsBefore;
 
-    if (keyW)
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "%d of %zu culled outside, %d at the entrance",
+                  culledOutside, sceneInstanceCount, culledEntrance);
+    selfTestResult(ok, "occlusion", detail);
+    checkBudget("occlusion_cull", medianMs(times), -1, allocs);
+}
+
+// Views: a camera move only invalidates the perspective view, the fan
+// leaves the elevation alone; dragging the desk in the plan invalidates all
+// three and carries its 3D pieces and pick shape along. Clicks in the split
+// and window layouts reach the view under them, in queue order.
+void runViewSelfTests()
+{
+    ViewLayout savedLayout = viewLayout;
+    viewLayout = LAYOUT_SPLIT;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        placeView((ViewKind)k, 0, 0, 0, SELFTEST_3D_WIDTH, SELFTEST_3D_HEIGHT);
+
+    uint64_t before[VIEW_KIND_COUNT], after[VIEW_KIND_COUNT];
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k) before[k] = viewInputsHash((ViewKind)k);
+    camYawDeg += 15.0f;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k) after[k] = viewInputsHash((ViewKind)k);
+    camYawDeg -= 15.0f;
+    bool ok = before[VIEW_PLAN] == after[VIEW_PLAN] && before[VIEW_ELEVATION] == after[VIEW_ELEVATION]
+           && before[VIEW_PERSPECTIVE] != after[VIEW_PERSPECTIVE];
+
+    fanAngleDeg += 10.0f;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k) after[k] = viewInputsHash((ViewKind)k);
+    fanAngleDeg -= 10.0f;
+    ok = ok && before[VIEW_PLAN] == after[VIEW_PLAN] && before[VIEW_ELEVATION] == after[VIEW_ELEVATION]
+            && before[VIEW_PERSPECTIVE] != after[VIEW_PERSPECTIVE];
+
+    planMoveX[PLAN_DESK] = 200;
+    planMoveY[PLAN_DESK] = 100;
+    applyFurnitureMoves();
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        ok = ok && viewInputsHash((ViewKind)k) != before[k];
+
+    float dx = 200 / PLAN_PX_PER_M_X, dz = -100 / PLAN_PX_PER_M_Z;
+    const int carried[] = { OBJ_DESK, OBJ_MONITOR, OBJ_KEYBOARD, OBJ_LAMP };
+    for (size_t i = 0; i < sizeof(carried) / sizeof(carried[0]); ++i)
     {
-        camX += forwardX * MOVE_SPEED;
-        camZ += forwardZ * MOVE_SPEED;
+        const SceneInstance& s = sceneInstances[carried[i]];
+        ok = ok && std::fabs(s.x - (layoutObjects[carried[i]].x + dx)) < 1e-4f
+                && std::fabs(s.z - (layoutObjects[carried[i]].z + dz)) < 1e-4f;
     }
-    if (keyS)
+    ok = ok && sceneInstances[OBJ_TABLE].x == layoutObjects[OBJ_TABLE].x;
+    int hit = pickPlanPoint(320.0f + 200.0f, 485.0f + 100.0f);
+    ok = ok && hit >= 0 && std::strcmp(pickObjects[hit].name, "Desk") == 0;
+
+    planMoveX[PLAN_DESK] = planMoveY[PLAN_DESK] = 0;
+    applyFurnitureMoves();
+    selfTestResult(ok, "views", "per-view invalidation, desk drag");
+
+    // Split screen at 1000x900, clicked at each view's content
+    mainWindow = 1;   // no GLUT here; any id the views are placed in
+    gWindowWidth = 1000; gWindowHeight = 900;
+    layoutViews();
+    camX = 0.0f; camY = 1.7f; camZ = ROOM_HALF_DEPTH - 1.0f;
+    camYawDeg = 180.0f; camPitchDeg = -10.0f;
+    doorAngleDeg = 0.0f;
+
+    const View& plan = views[VIEW_PLAN];
+    PlanFraming f = viewPlanFraming(plan);
+    int deskX = plan.x + (int)(f.x + (320.0 - PLAN_EXTENT_MIN_X) * f.scale);
+    int deskY = plan.y + (int)(f.y + (485.0 - PLAN_EXTENT_MIN_Y) * f.scale);
+    const View& persp = views[VIEW_PERSPECTIVE];
+    const View& elev  = views[VIEW_ELEVATION];
+    struct Click { int mx, my; const char* expect; };
+    const Click clicks[] = {
+        { deskX,                   gWindowHeight - 1 - deskY,                   "Desk"          },
+        { persp.x + persp.w / 2,   gWindowHeight - 1 - (persp.y + persp.h / 2), "Meeting table" },
+        { elev.x + elev.w / 2,     gWindowHeight - 1 - (elev.y + elev.h / 2),   "Whiteboard"    },
+        { plan.x + plan.w,         gWindowHeight / 2,                           nullptr         },  // gutter
+    };
+    bool clicksOk = true;
+    for (size_t c = 0; c < sizeof(clicks) / sizeof(clicks[0]); ++c)
     {
-        camX -= forwardX * MOVE_SPEED;
-        camZ -= forwardZ * MOVE_SPEED;
+        int hit = pickInWindow(mainWindow, clicks[c].mx, clicks[c].my);
+        const char* got = (hit >= 0) ? pickObjects[hit].name : nullptr;
+        bool ok = (got && clicks[c].expect) ? std::strcmp(got, clicks[c].expect) == 0 : got == clicks[c].expect;
+        if (!ok)
+        {
+            std::printf("       split click %d: expected %s, got %s\n", (int)c,
+                        clicks[c].expect ? clicks[c].expect : "nothing", got ? got : "nothing");
+            clicksOk = false;
+        }
     }
-    if (keyA)
+    int x, y;
+    clicksOk = clicksOk && viewAt(mainWindow, plan.x + plan.w, gWindowHeight / 2, x, y) < 0;
+
+    // Clicks drain in queue order: press-release-press on the desk within
+    // one frame leaves the second press's drag running, and a press on the
+    // empty plan after a release leaves nothing selected or dragged
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    const InputEvent deskClicks[] = {
+        { INPUT_MOUSE_PRESS,   0, mainWindow, deskX, gWindowHeight - 1 - deskY, now },
+        { INPUT_MOUSE_RELEASE, 0, mainWindow, deskX, gWindowHeight - 1 - deskY, now },
+        { INPUT_MOUSE_PRESS,   0, mainWindow, deskX, gWindowHeight - 1 - deskY, now },
+    };
+    std::chrono::steady_clock::time_point oldest;
+    inputQueue.assign(deskClicks, deskClicks + 3);
+    processInput(oldest);
+    clicksOk = clicksOk && dragItem == PLAN_DESK && selectedObject >= 0 &&
+               std::strcmp(pickObjects[selectedObject].name, "Desk") == 0;
+    const InputEvent emptyClick[] = {
+        deskClicks[1],
+        { INPUT_MOUSE_PRESS, 0, mainWindow, plan.x + 1, gWindowHeight - 2 - plan.y, now },
+    };
+    inputQueue.assign(emptyClick, emptyClick + 2);
+    processInput(oldest);
+    clicksOk = clicksOk && dragItem < 0 && selectedObject < 0;
+
+    // The perspective in a window of its own; the plan keeps the main window
+    viewLayout = LAYOUT_WINDOWS;
+    ViewWindow savedWindow = viewWindows[VIEW_PERSPECTIVE];
+    viewWindows[VIEW_PERSPECTIVE] = { 2, 640, 480 };
+    layoutViews();
+    clicksOk = clicksOk && viewAt(2, 320, 240, x, y) == VIEW_PERSPECTIVE && x == 320 && y == 239
+                        && viewAt(mainWindow, 320, 240, x, y) == VIEW_PLAN
+                        && pickInWindow(2, 320, 240) >= 0
+                        && std::strcmp(pickObjects[pickInWindow(2, 320, 240)].name, "Meeting table") == 0;
+    viewWindows[VIEW_PERSPECTIVE] = savedWindow;
+
+    viewLayout = savedLayout;
+    mainWindow = 0;
+    layoutViews();
+    selfTestResult(clicksOk, "view_clicks", "split screen and view windows");
+}
+
+// Views on a GL context: an idle split-screen frame only blits the cached
+// images, and each view culls for its own camera. The blits go to the
+// context's default framebuffer (none when surfaceless); only the counts
+// are checked.
+void runViewFrameSelfTest()
+{
+    if (!hasFramebufferBlit)
     {
-        camX -= rightX * MOVE_SPEED;
-        camZ -= rightZ * MOVE_SPEED;
+        selfTestResult(false, "view_frame", "framebuffer blit unavailable");
+        return;
     }
-    if (keyD)
+
+    ViewLayout savedLayout = viewLayout;
+    float savedFanSpeed = fanSpeedDeg;
+    viewLayout = LAYOUT_SPLIT;
+    mainWindow = 1;   // drawWindowViews only matches it against the views
+    gWindowWidth = 1000; gWindowHeight = 900;
+    layoutViews();
+    selectedObject = -1;
+    fanSpeedDeg = 0.0f;
+    doorAngleDeg = 0.0f;
+    setCrowdEnabled(false);
+    camX = 0.0f; camY = 1.6f; camZ = -5.0f;   // at the back, facing the back wall
+    camYawDeg = 180.0f; camPitchDeg = 0.0f;
+
+    drawWindowViews(mainWindow, gWindowWidth, gWindowHeight);
+    int renders[VIEW_KIND_COUNT];
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k) renders[k] = views[k].renders;
+
+    std::vector<double> times;
+    for (int i = 0; i < SELFTEST_TIMING_RUNS; ++i)
     {
-        camX += rightX * MOVE_SPEED;
-        camZ += rightZ * MOVE_SPEED;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        drawWindowViews(mainWindow, gWindowWidth, gWindowHeight);
+        glFinish();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
     }
-    if (keyQ) camY -= MOVE_SPEED;
-    if (keyE) camY += MOVE_SPEED;
+    long allocsBefore = heapAllocCount.load();
+    drawWindowViews(mainWindow, gWindowWidth, gWindowHeight);
+    long allocs = heapAllocCount.load() - allocsBefore;
+    int drawCalls = frameStats.drawCalls;
 
-    // Clamp to room bounds (stay inside)
-    float margin = 0.6f;
-    if (camX < -ROOM_HALF_WIDTH  + margin) camX = -ROOM_HALF_WIDTH  + margin;
-    if (camX >  ROOM_HALF_WIDTH  - margin) camX =  ROOM_HALF_WIDTH  - margin;
-    if (camZ < -ROOM_HALF_DEPTH  + margin) camZ = -ROOM_HALF_DEPTH  + margin;
-    if (camZ >  ROOM_HALF_DEPTH  - margin) camZ =  ROOM_HALF_DEPTH  - margin;
-    if (camY < 0.7f)             camY = 0.7f;
-    if (camY > ROOM_HEIGHT - 0.3f) camY = ROOM_HEIGHT - 0.3f;
+    bool idle = drawCalls == VIEW_KIND_COUNT;
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k) idle = idle && views[k].renders == renders[k];
+
+    // The perspective culls with its own matrix, the elevation with its own
+    const View& persp = views[VIEW_PERSPECTIVE];
+    float viewProj[16];
+    cameraViewProjection((double)persp.w / persp.h, viewProj);
+    int expected = cullSceneInstances(viewProj, fanAngleDeg);
+    bool culls = persp.culledObjects == expected && expected > 0
+              && views[VIEW_ELEVATION].culledObjects != expected;
+
+    char detail[96];
+    std::snprintf(detail, sizeof(detail), "idle frame %d draw calls; culled %d perspective, %d elevation",
+                  drawCalls, persp.culledObjects, views[VIEW_ELEVATION].culledObjects);
+    selfTestResult(idle && culls, "view_frame", detail);
+    checkBudget("views_idle_frame", medianMs(times), drawCalls, allocs, selfTest.glComparable);
+
+    for (int k = 0; k < VIEW_KIND_COUNT; ++k)
+        destroyOffscreenTarget(views[k].fbo, views[k].colorRb, views[k].depthRb);
+    fanSpeedDeg = savedFanSpeed;
+    viewLayout = savedLayout;
+    mainWindow = 0;
+    layoutViews();
 }
 
-// --------------------------------------------------
-// TIMER – FAN + DOOR + CAMERA
-// --------------------------------------------------
-void timer(int)
+// 3D: fixed camera poses rendered offscreen at a fixed animation state
+void run3DSelfTests()
 {
-    // Fan spin (uses adjustable speed)
-    fanAngleDeg += fanSpeedDeg;
-    if (fanAngleDeg >= 360.0f) fanAngleDeg -= 360.0f;
+    GLuint fbo, colorRb, depthRb;
+    if (!createOffscreenTarget(SELFTEST_3D_WIDTH, SELFTEST_3D_HEIGHT, fbo, colorRb, depthRb))
+    {
+        selfTestResult(false, "3D cases", "framebuffer objects unavailable");
+        return;
+    }
 
-    // Door animation
-    float targetAngle = doorOpen ? DOOR_MAX_ANGLE : 0.0f;
-    float diff = targetAngle - doorAngleDeg;
-    float step = 3.0f;
+    struct ViewCase { const char* name; float x, y, z, yaw, pitch; bool doorOpen; };
+    const ViewCase cases[] = {
+        { "scene_entrance", 0.0f,  1.7f, 7.0f, 180.0f, -10.0f, false },
+        { "scene_desk",    -1.0f,  1.6f, 1.5f, 223.0f, -20.0f, false },
+        { "scene_corner",   4.5f,  2.5f, 6.5f, 213.0f, -15.0f, true  },
+    };
 
-    if (std::fabs(diff) > 0.1f)
-        doorAngleDeg += (diff > 0 ? step : -step);
+    gWindowWidth  = SELFTEST_3D_WIDTH;
+    gWindowHeight = SELFTEST_3D_HEIGHT;
+    pglBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, SELFTEST_3D_WIDTH, SELFTEST_3D_HEIGHT);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
 
-    // Update camera movement
-    updateCamera();
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+    {
+        const ViewCase& v = cases[c];
+        is3DMode = true;
+        selectedObject = -1;
+        camX = v.x; camY = v.y; camZ = v.z;
+        camYawDeg = v.yaw; camPitchDeg = v.pitch;
+        fanAngleDeg  = 30.0f;
+        doorAngleDeg = v.doorOpen ? DOOR_MAX_ANGLE : 0.0f;
 
-    glutPostRedisplay();
-    glutTimerFunc(16, timer, 0); // ~60 FPS
+        renderScene(); // warm-up
+        glFinish();
+
+        std::vector<double> times;
+        for (int i = 0; i < SELFTEST_TIMING_RUNS; ++i)
+        {
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            renderScene();
+            glFinish();
+            times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+        }
+
+        long allocsBefore = heapAllocCount.load();
+        renderScene();
+        long allocs = heapAllocCount.load() - allocsBefore;
+        int drawCalls = frameStats.drawCalls;
+
+        std::vector<unsigned char> rgba((size_t)SELFTEST_3D_WIDTH * SELFTEST_3D_HEIGHT * 4);
+        glReadPixels(0, 0, SELFTEST_3D_WIDTH, SELFTEST_3D_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, &rgba[0]);
+
+        if (selfTest.glComparable)
+        {
+            checkImage(v.name, SELFTEST_3D_WIDTH, SELFTEST_3D_HEIGHT, rgba, GOLDEN_MAX_BAD_FRACTION_3D);
+        }
+        else if (recordingGolden(v.name))
+        {
+            selfTestResult(false, v.name, "3D goldens are from " + selfTest.renderer +
+                           "; re-record all of them here with --update-golden renderer scene_...");
+        }
+        else
+        {
+            std::printf("[SKIP] %-22s golden is from %s, this renderer is %s\n", v.name,
+                        selfTest.renderer.c_str(), selfTest.glRenderer.c_str());
+            ++selfTest.skipped;
+        }
+        checkBudget(v.name, medianMs(times), drawCalls, allocs, selfTest.glComparable);
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    destroyOffscreenTarget(fbo, colorRb, depthRb);
 }
 
-// --------------------------------------------------
-// INIT
-// --------------------------------------------------
-void initGL()
+#ifndef _WIN32
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// Mesa's surfaceless platform needs no display server; other EGLs use their
+// default display. Everything draws into FBOs, so a context without a
+// surface is enough, with a 1x1 pbuffer for EGLs that insist on one.
+bool createEglContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) return false;
+    }
+
+    const EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                     EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_NONE };
+    EGLConfig config;
+    EGLint    configCount = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(display, configAttribs, &config, 1, &configCount) || configCount < 1)
+        return false;
+
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (context == EGL_NO_CONTEXT) return false;
+    if (eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return true;
+
+    const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+    return surface != EGL_NO_SURFACE && eglMakeCurrent(display, surface, surface, context);
+}
+#endif
+
+// A GL context for the GL cases: headless EGL where available, else a
+// hidden GLUT window (which needs a display on X11). Mesa is asked for its
+// software renderer, which the 3D goldens were recorded with.
+bool createSelfTestContext(int& argc, char** argv)
+{
+#ifndef _WIN32
+    setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+    if (createEglContext()) return true;
+    if (!std::getenv("DISPLAY")) return false;
+#endif
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+    glutInitWindowSize(SELFTEST_3D_WIDTH, SELFTEST_3D_HEIGHT);
+    glutCreateWindow("Office Designer - self test");
+    glutHideWindow();
+    return true;
+}
+
+// --selftest [--skip-gl] [--update-golden [case ...]]
+int runSelfTest(int argc, char** argv)
 {
-    glClearColor(0.05f, 0.05f, 0.10f, 1.0f);
+    for (int i = 2; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--skip-gl") == 0)           selfTest.skipGL = true;
+        else if (std::strcmp(argv[i], "--update-golden") == 0) selfTest.updateGolden = true;
+        else if (selfTest.updateGolden)                        selfTest.recordOnly.push_back(argv[i]);
+        else
+        {
+            std::printf("Unknown self test option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (selfTest.updateGolden)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(GOLDEN_DIR, ec);
+    }
+    loadBudgets();
+
+    // Time limits recorded on another machine scale by the reference workload
+    double referenceMs = measureReferenceMs();
+    if (selfTest.referenceMs <= 0.0 || recordingGolden("reference"))
+    {
+        selfTest.referenceMs = referenceMs;
+        selfTest.machine     = machineDescription();
+    }
+    selfTest.timeScale = referenceMs / selfTest.referenceMs;
+    std::printf("Reference workload: %.4f ms here, %.4f ms on %s (time limits x%.2f)\n",
+                referenceMs, selfTest.referenceMs, selfTest.machine.c_str(), selfTest.timeScale);
+
+    selfTestResult(verifyRasterKernels(), "raster_kernels", "span kernels vs reference");
+    definePickObjects();
+    buildPickingBvh();
+    runPlanSelfTests();
+    runPickingSelfTests();
+    runSceneCacheSelfTests();
+    runCrowdSelfTests();
+    runOcclusionSelfTests();
+    runViewSelfTests();
+
+    if (selfTest.skipGL)
+    {
+        std::printf("[SKIP] GL cases (--skip-gl)\n");
+        ++selfTest.skipped;
+    }
+    else if (createSelfTestContext(argc, argv))
+    {
+        initGL();
+
+        // Renderer name without the version details, e.g. "llvmpipe"
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        selfTest.glRenderer = renderer ? renderer : "unknown";
+        selfTest.glRenderer = selfTest.glRenderer.substr(0, selfTest.glRenderer.find(" ("));
+        if (selfTest.renderer.empty() ? selfTest.updateGolden : recordingGolden("renderer"))
+            selfTest.renderer = selfTest.glRenderer;
+        selfTest.glComparable = selfTest.glRenderer == selfTest.renderer;
+        if (!selfTest.glComparable)
+            std::printf("GL renderer is %s, the 3D goldens are from %s: images and GL timings skipped\n",
+                        selfTest.glRenderer.c_str(), selfTest.renderer.c_str());
+
+        runPlanFrameSelfTest();
+        run3DSelfTests();
+        runViewFrameSelfTest();
+    }
+    else
+    {
+        selfTestResult(false, "GL cases", "no GL context (--skip-gl to skip them)");
+    }
+
+    if (selfTest.updateGolden) saveBudgets();
+
+    std::printf("\n%d passed, %d failed, %d skipped\n", selfTest.passed, selfTest.failed, selfTest.skipped);
+    return selfTest.failed ? 1 : 0;
 }
+#endif
 
 // --------------------------------------------------
 // MAIN
 // --------------------------------------------------
 int main(int argc, char** argv)
 {
+    // --selftest [--skip-gl] [--update-golden [case ...]] : golden images + frame budgets
+    if (argc >= 2 && std::strcmp(argv[1], "--selftest") == 0)
+    {
+#ifdef OFFICE_SELFTEST
+        return runSelfTest(argc, argv);
+#else
+        std::fprintf(stderr, "--selftest needs a build with -DOFFICE_SELFTEST\n");
+        return 1;
+#endif
+    }
+
+    // --verify-raster : span kernels vs the reference algorithms
+    if (argc >= 2 && std::strcmp(argv[1], "--verify-raster") == 0)
+        return verifyRasterKernels() ? 0 : 1;
+
+    // --export-plan <out.ppm> <width> : headless, no window needed
+    if (argc >= 4 && std::strcmp(argv[1], "--export-plan") == 0)
+        return exportPlanImage(argv[2], std::atoi(argv[3])) ? 0 : 1;
+
+    // --capture <path file> <out dir> [width height] : render and exit
+    bool captureRun = argc >= 4 && std::strcmp(argv[1], "--capture") == 0;
+    int  captureW   = (captureRun && argc >= 6) ? std::atoi(argv[4]) : 1920;
+    int  captureH   = (captureRun && argc >= 6) ? std::atoi(argv[5]) : 1080;
+    if (captureRun && (captureW <= 0 || captureH <= 0 ||
+                       captureW > CAPTURE_MAX_SIZE || captureH > CAPTURE_MAX_SIZE))
+    {
+        std::fprintf(stderr, "--capture: width and height must be 1..%d\n", CAPTURE_MAX_SIZE);
+        return 1;
+    }
+
+    loadOrBuildScene();
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
     glutInitWindowSize(gWindowWidth, gWindowHeight);
-    glutCreateWindow("Office Designer - Part 1 (2D + Full 3D FPS Preview)");
+    mainWindow = glutCreateWindow(WINDOW_TITLE);
 
     initGL();
 
-    glutDisplayFunc(display);
-    glutReshapeFunc(reshape);
-    glutKeyboardFunc(keyboard);
-    glutKeyboardUpFunc(keyboardUp);
-    glutPassiveMotionFunc(passiveMouseMotion);
+    registerWindowCallbacks();
+    glutCloseFunc(mainWindowClosed);
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);   // view windows can close alone
     glutTimerFunc(16, timer, 0);
 
+    inputQueue.reserve(INPUT_QUEUE_RESERVE);
+    latencySamples.reserve(1024);
+
+    if (captureRun)
+        beginCapture(argv[2], argv[3], captureW, captureH, true);
+
     glutMainLoop();
     return 0;
 }